@@ -0,0 +1,83 @@
+#include "alert_engine.h"
+#include "ssd1309_gfx.h"
+#include <string.h>
+
+// Rule table, add new alerts here (and an ID in alert_engine.h)
+static const alert_rule_t rules[] = {
+    { ALERT_ENG_TEMP, SIG_ENG_TEMP, ALERT_ABOVE, 90.0f, 3.0f,  0, "E" },
+    { ALERT_CVT_TEMP, SIG_CVT_TEMP, ALERT_ABOVE, 90.0f, 3.0f,  1, "T" },
+    { ALERT_LOW_BAT,  SIG_VOLTAGE,  ALERT_BELOW, 11.8f, 0.2f,  2, "B" },
+    { ALERT_LOW_FUEL, SIG_FUEL,     ALERT_BELOW, 20.0f, 2.0f,  3, "F" },
+};
+#define RULE_COUNT (sizeof(rules) / sizeof(rules[0]))
+
+static alert_state_t dash_state;
+
+static void read_signals(const car_state_t *car, float *out) {
+    out[SIG_RPM]      = car->rpm;
+    out[SIG_SPEED]    = car->speed;
+    out[SIG_FUEL]     = car->fuel;
+    out[SIG_VOLTAGE]  = car->voltage;
+    out[SIG_CVT_TEMP] = car->cvt_temp;
+    out[SIG_ENG_TEMP] = car->eng_temp;
+}
+
+static bool rule_active(const alert_rule_t *r, float val, bool was_active) {
+    // Move the threshold out by the hysteresis band while active, so noise
+    // around the boundary doesn't make the icon flicker
+    float limit = r->threshold;
+    if (was_active) {
+        limit += (r->cmp == ALERT_BELOW) ? r->hysteresis : -r->hysteresis;
+    }
+    return (r->cmp == ALERT_BELOW) ? (val < limit) : (val > limit);
+}
+
+void alert_state_reset(alert_state_t *st) {
+    st->evaluated = false;
+    st->active_mask = 0;
+}
+
+alert_mask_t alert_state_update(alert_state_t *st, const car_state_t *car) {
+    float inputs[SIG_COUNT];
+    read_signals(car, inputs);
+
+    // Nothing changed since last time, keep the published mask
+    if (st->evaluated && memcmp(inputs, st->last_inputs, sizeof(inputs)) == 0) {
+        return st->active_mask;
+    }
+    memcpy(st->last_inputs, inputs, sizeof(inputs));
+    st->evaluated = true;
+
+    alert_mask_t mask = 0;
+    for (size_t i = 0; i < RULE_COUNT; i++) {
+        const alert_rule_t *r = &rules[i];
+        bool was_active = (st->active_mask & ALERT_BIT(r->id)) != 0;
+        if (rule_active(r, inputs[r->signal], was_active)) {
+            mask |= ALERT_BIT(r->id);
+        }
+    }
+    st->active_mask = mask;
+    return st->active_mask;
+}
+
+void alert_engine_reset(void) {
+    alert_state_reset(&dash_state);
+}
+
+alert_mask_t alert_engine_update(const car_state_t *car) {
+    return alert_state_update(&dash_state, car);
+}
+
+alert_mask_t alert_engine_active(void) {
+    return dash_state.active_mask;
+}
+
+void alert_engine_draw(uint8_t *fb, int x, int y, alert_mask_t mask, bool blink_on) {
+    if (!blink_on || mask == 0) return;
+    for (size_t i = 0; i < RULE_COUNT; i++) {
+        const alert_rule_t *r = &rules[i];
+        if (mask & ALERT_BIT(r->id)) {
+            ssd1309_draw_string(fb, x + r->priority * ALERT_ICON_SPACING, y, r->icon);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_management.h"
+
+// Spacing between alert icons on the status line, in pixels
+#define ALERT_ICON_SPACING  10
+
+// --- Alert IDs (bit positions in the active mask) ---
+typedef enum {
+    ALERT_ENG_TEMP = 0,
+    ALERT_CVT_TEMP,
+    ALERT_LOW_BAT,
+    ALERT_LOW_FUEL,
+    ALERT_COUNT
+} alert_id_t;
+
+typedef uint32_t alert_mask_t;
+#define ALERT_BIT(id)   ((alert_mask_t)1 << (id))
+
+// Signals a rule can watch
+typedef enum {
+    SIG_RPM = 0,
+    SIG_SPEED,
+    SIG_FUEL,
+    SIG_VOLTAGE,
+    SIG_CVT_TEMP,
+    SIG_ENG_TEMP,
+    SIG_COUNT
+} alert_signal_t;
+
+typedef enum {
+    ALERT_BELOW,    // Active while value < threshold
+    ALERT_ABOVE,    // Active while value > threshold
+} alert_cmp_t;
+
+// One row of the rule table
+// An active alert only clears once the value is back past threshold +/- hysteresis
+typedef struct {
+    alert_id_t id;
+    alert_signal_t signal;
+    alert_cmp_t cmp;
+    float threshold;
+    float hysteresis;
+    uint8_t priority;   // 0 = most urgent, also the icon slot (leftmost)
+    const char *icon;
+} alert_rule_t;
+
+// Evaluation state, one per stream of car states (the dashboard has one,
+// a host renderer has one per thread)
+typedef struct {
+    float last_inputs[SIG_COUNT];
+    bool evaluated;
+    alert_mask_t active_mask;
+} alert_state_t;
+
+void alert_state_reset(alert_state_t *st);
+// Re-evaluates the rule table only if a watched signal changed
+// Returns the active-alert bitmask
+alert_mask_t alert_state_update(alert_state_t *st, const car_state_t *car);
+
+// Same, on the dashboard's own state
+void alert_engine_reset(void);
+alert_mask_t alert_engine_update(const car_state_t *car);
+alert_mask_t alert_engine_active(void);
+// Draws every alert in mask on one line starting at (x, y)
+// Icons are hidden when blink_on is false so all modes blink in sync
+void alert_engine_draw(uint8_t *fb, int x, int y, alert_mask_t mask, bool blink_on);
@@ -0,0 +1,166 @@
+#include "button_input.h"
+#include "esp_log.h"
+#include "sys_clock.h"
+
+#define TAG "BUTTON"
+#define NO_DEADLINE -1
+
+// Where the current press is in its gesture
+typedef enum {
+    ST_IDLE,
+    ST_DOWN,            // First press held, long if it lasts
+    ST_WAIT_SECOND,     // Released, short unless pressed again in time
+    ST_WAIT_RELEASE,    // Gesture already sent, ignore the rest of the press
+} press_state_t;
+
+static button_event_t queue[BUTTON_QUEUE_LEN];
+static uint32_t q_head, q_tail;
+static button_stats_t stats;
+static portMUX_TYPE button_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t button_task_handle = NULL;
+static TaskHandle_t notify_task = NULL;
+static gpio_num_t button_pin;
+
+// Button task only
+static press_state_t state = ST_IDLE;
+static int64_t press_us;
+static int64_t deadline_us = NO_DEADLINE;
+
+static void IRAM_ATTR button_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(button_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void emit(button_gesture_t gesture)
+{
+    portENTER_CRITICAL(&button_lock);
+    if (q_head - q_tail >= BUTTON_QUEUE_LEN) {
+        q_tail++;
+        stats.dropped++;
+    }
+    queue[q_head++ % BUTTON_QUEUE_LEN] = (button_event_t){ gesture, press_us };
+    if (gesture == BUTTON_SHORT) stats.shorts++;
+    else if (gesture == BUTTON_LONG) stats.longs++;
+    else stats.doubles++;
+    portEXIT_CRITICAL(&button_lock);
+
+    if (notify_task) xTaskNotifyGive(notify_task);
+}
+
+// A debounced level change, at the time of its first edge
+static void on_edge(bool down, int64_t at_us)
+{
+    switch (state) {
+        case ST_IDLE:
+            if (!down) break;
+            press_us = at_us;
+            deadline_us = at_us + BUTTON_LONG_MS * 1000LL;
+            state = ST_DOWN;
+            break;
+        case ST_DOWN:
+            if (down) break;
+            deadline_us = at_us + BUTTON_DOUBLE_MS * 1000LL;
+            state = ST_WAIT_SECOND;
+            break;
+        case ST_WAIT_SECOND:
+            if (!down) break;
+            // Sent on the second press, not its release: nothing left to tell apart
+            emit(BUTTON_DOUBLE);
+            deadline_us = NO_DEADLINE;
+            state = ST_WAIT_RELEASE;
+            break;
+        case ST_WAIT_RELEASE:
+            if (!down) state = ST_IDLE;
+            break;
+    }
+}
+
+static void on_deadline(void)
+{
+    deadline_us = NO_DEADLINE;
+    if (state == ST_DOWN) {
+        emit(BUTTON_LONG);
+        state = ST_WAIT_RELEASE;
+    } else if (state == ST_WAIT_SECOND) {
+        emit(BUTTON_SHORT);
+        state = ST_IDLE;
+    }
+}
+
+static void button_task(void *arg)
+{
+    bool down = gpio_get_level(button_pin) == 0;
+    // Held through boot: that press is not the pilot's
+    if (down) state = ST_WAIT_RELEASE;
+
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+        if (deadline_us != NO_DEADLINE) {
+            int64_t wait_ms = (deadline_us - sys_clock_us() + 999) / 1000;
+            if (wait_ms < (int64_t)portTICK_PERIOD_MS) wait_ms = portTICK_PERIOD_MS;
+            wait = pdMS_TO_TICKS(wait_ms);
+        }
+        uint32_t edges = ulTaskNotifyTake(pdTRUE, wait);
+        if (edges) {
+            // The contact bounces: every new edge restarts the quiet time
+            int64_t edge_us = sys_clock_us();
+            uint32_t more;
+            while ((more = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BUTTON_DEBOUNCE_MS))) > 0) edges += more;
+            portENTER_CRITICAL(&button_lock);
+            stats.edges += edges;
+            portEXIT_CRITICAL(&button_lock);
+
+            // A deadline that passed while settling came first
+            if (deadline_us != NO_DEADLINE && edge_us >= deadline_us) on_deadline();
+            bool level_down = gpio_get_level(button_pin) == 0;
+            if (level_down != down) {
+                down = level_down;
+                on_edge(down, edge_us);
+            }
+        }
+        if (deadline_us != NO_DEADLINE && sys_clock_us() >= deadline_us) on_deadline();
+    }
+}
+
+esp_err_t button_init(gpio_num_t pin, TaskHandle_t notify)
+{
+    if (button_task_handle) return ESP_ERR_INVALID_STATE;
+    button_pin = pin;
+    notify_task = notify;
+
+    gpio_set_direction(pin, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+    gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+
+    if (xTaskCreate(button_task, "button", BUTTON_TASK_STACK, NULL,
+                    BUTTON_TASK_PRIORITY, &button_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start button task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Someone else may have installed the service already
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;
+    return gpio_isr_handler_add(pin, button_isr, NULL);
+}
+
+bool button_get_event(button_event_t *ev)
+{
+    bool got = false;
+    portENTER_CRITICAL(&button_lock);
+    if (q_tail != q_head) {
+        *ev = queue[q_tail++ % BUTTON_QUEUE_LEN];
+        got = true;
+    }
+    portEXIT_CRITICAL(&button_lock);
+    return got;
+}
+
+void button_get_stats(button_stats_t *out)
+{
+    portENTER_CRITICAL(&button_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&button_lock);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+// --- BUTTON ---
+// The pin interrupt wakes a small task on every edge. It waits for the
+// contact to settle, turns presses into gestures and queues them for the
+// main loop, poking it so a press is handled on the next frame, not the
+// next poll. Nobody reads the pin in a loop any more
+#define BUTTON_TASK_PRIORITY    5
+#define BUTTON_TASK_STACK       2048
+#define BUTTON_DEBOUNCE_MS      30      // Quiet time after an edge before the level counts
+#define BUTTON_LONG_MS          1500    // Held this long = long press, sent while still held
+#define BUTTON_DOUBLE_MS        250     // Gap a second press has to come in. Short presses wait it out
+#define BUTTON_QUEUE_LEN        8       // Power of two, the oldest event goes when full
+
+typedef enum {
+    BUTTON_SHORT,
+    BUTTON_LONG,
+    BUTTON_DOUBLE,
+} button_gesture_t;
+
+typedef struct {
+    button_gesture_t gesture;
+    int64_t time_us;        // sys_clock time of the (first) press
+} button_event_t;
+
+typedef struct {
+    uint32_t shorts;
+    uint32_t longs;
+    uint32_t doubles;
+    uint32_t edges;         // Interrupts taken, bounces included
+    uint32_t dropped;       // Events pushed out of a full queue
+} button_stats_t;
+
+// Active low pin with the internal pull-up. notify gets xTaskNotifyGive
+// for every queued event, NULL for none
+esp_err_t button_init(gpio_num_t pin, TaskHandle_t notify);
+// Oldest queued event, never blocks. false when there is none
+bool button_get_event(button_event_t *ev);
+void button_get_stats(button_stats_t *stats);
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "can_id_stats.h"
+#include "freertos/FreeRTOS.h"
+
+// Never deleted from, so plain linear probing. Only the CAN task writes
+static can_id_stat_t table[CAN_ID_STATS_LEN];
+static bool used[CAN_ID_STATS_LEN];
+static uint32_t overflow;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t slot_of(uint32_t key)
+{
+    return (key * 2654435761u) % CAN_ID_STATS_LEN;      // Knuth multiplicative hash
+}
+
+// Entry for key, claimed if new. NULL when the table is full
+static can_id_stat_t *find(uint32_t key)
+{
+    uint32_t i = slot_of(key);
+    for (int n = 0; n < CAN_ID_STATS_LEN; n++, i = (i + 1) % CAN_ID_STATS_LEN) {
+        if (!used[i]) {
+            used[i] = true;
+            memset(&table[i], 0, sizeof(table[i]));
+            table[i].id = key;
+            return &table[i];
+        }
+        if (table[i].id == key) return &table[i];
+    }
+    return NULL;
+}
+
+void can_id_stats_init(void)
+{
+    static const struct { uint32_t id; uint16_t ms; } expected[] = CAN_ID_EXPECTED;
+    portENTER_CRITICAL(&stats_lock);
+    memset(used, 0, sizeof(used));
+    overflow = 0;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        can_id_stat_t *e = find(expected[i].id);
+        if (e) e->expected_ms = expected[i].ms;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void can_id_stats_update(uint32_t id, bool extd, int64_t now_us)
+{
+    portENTER_CRITICAL(&stats_lock);
+    can_id_stat_t *e = find(extd ? id | CAN_ID_EXTD : id);
+    if (!e) {
+        overflow++;
+    } else if (e->count++ == 0) {
+        e->first_us = now_us;
+        e->last_us = now_us;
+    } else {
+        uint32_t interval = (uint32_t)(now_us - e->last_us);
+        e->last_us = now_us;
+        if (interval > e->max_us) e->max_us = interval;
+        if (e->count == 2) {
+            e->avg_us = interval;
+        } else {
+            // Exponential averages in integers, like RFC 3550 jitter
+            int32_t dev = (int32_t)(interval - e->avg_us);
+            e->avg_us += dev >> CAN_ID_AVG_SHIFT;
+            uint32_t abs_dev = dev < 0 ? -dev : dev;
+            e->jitter_us += ((int32_t)(abs_dev - e->jitter_us)) >> CAN_ID_AVG_SHIFT;
+        }
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+int can_id_stats_get(can_id_stat_t *out, int max)
+{
+    int n = 0;
+    portENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < CAN_ID_STATS_LEN && n < max; i++) {
+        if (used[i]) out[n++] = table[i];
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    // Insertion sort, a few dozen entries at most
+    for (int i = 1; i < n; i++) {
+        can_id_stat_t e = out[i];
+        int j = i;
+        for (; j > 0 && out[j - 1].id > e.id; j--) out[j] = out[j - 1];
+        out[j] = e;
+    }
+    return n;
+}
+
+uint32_t can_id_stats_overflow(void)
+{
+    return overflow;
+}
+
+can_id_status_t can_id_check(const can_id_stat_t *e, int64_t now_us)
+{
+    // Without a configured period, the recent one is all there is to go by
+    int64_t period_us = e->expected_ms ? e->expected_ms * 1000LL : e->avg_us;
+    if (e->count == 0) return e->expected_ms ? CAN_ID_MISSING : CAN_ID_OK;
+    if (period_us > 0 && now_us - e->last_us > CAN_ID_MISSING_PERIODS * period_us) return CAN_ID_MISSING;
+    if (e->expected_ms && e->count > 1) {
+        int64_t off = (int64_t)e->avg_us - period_us;
+        if (off < 0) off = -off;
+        if (off * 100 > period_us * CAN_ID_PERIOD_TOL_PCT) return CAN_ID_OFF_PERIOD;
+    }
+    return CAN_ID_OK;
+}
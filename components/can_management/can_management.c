@@ -1,32 +1,56 @@
 #include "can_management.h"
+#include "can_id_stats.h"
+#include "can_tx.h"
 #include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
+#include "sys_clock.h"
 #include <string.h>
 
 #define CAN_TX_PIN GPIO_NUM_5
 #define CAN_RX_PIN GPIO_NUM_18
 #define TAG "CAN_RX"
 
-void can_init(void) {
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(CAN_TX_PIN, CAN_RX_PIN, TWAI_MODE_NORMAL);
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+// State shared between the RX task and can_update_state()
+static car_state_t rx_state = {0};
+static bool rx_dirty = false;
+static portMUX_TYPE rx_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile can_box_alert_cb_t box_alert_cb = NULL;
+static can_frame_hook_t volatile frame_hooks[CAN_FRAME_HOOKS];
+static volatile uint32_t bus_off_count = 0;
+static can_health_t health = {0};
+static int64_t last_health_us = 0;
+static volatile uint32_t frames_received = 0;
 
-    // Install and start, always checking for errors
-    if (twai_driver_install(&g_config, &t_config, &f_config) == ESP_OK) {
-        ESP_LOGI(TAG, "Driver installed");
-    }
-    if (twai_start() == ESP_OK) {
-        ESP_LOGI(TAG, "Driver started");
-    }
+// Keeps what the driver reports, for the screen and the SD files
+static void can_sample_health(const twai_status_info_t *status) {
+    portENTER_CRITICAL(&rx_lock);
+    health.samples++;
+    health.state = status->state;
+    health.tx_err = status->tx_error_counter;
+    health.rx_err = status->rx_error_counter;
+    if (status->tx_error_counter > health.tx_err_max) health.tx_err_max = status->tx_error_counter;
+    if (status->rx_error_counter > health.rx_err_max) health.rx_err_max = status->rx_error_counter;
+    health.rx_queued = status->msgs_to_rx;
+    if (status->msgs_to_tx > health.tx_queued_max) health.tx_queued_max = status->msgs_to_tx;
+    health.rx_missed = status->rx_missed_count;
+    health.rx_overrun = status->rx_overrun_count;
+    health.arb_lost = status->arb_lost_count;
+    health.bus_error = status->bus_error_count;
+    health.tx_failed = status->tx_failed_count;
+    portEXIT_CRITICAL(&rx_lock);
 }
 
 // Helper to check for Bus-Off state and recover
 void can_recover_if_needed(void) {
     twai_status_info_t status;
+    last_health_us = sys_clock_us();
     if (twai_get_status_info(&status) == ESP_OK) {
+        can_sample_health(&status);
         if (status.state == TWAI_STATE_BUS_OFF) {
             ESP_LOGE(TAG, "Bus Off detected! Recovering...");
+            bus_off_count++;
             twai_initiate_recovery();
         }
         if (status.state == TWAI_STATE_STOPPED) {
@@ -36,47 +60,189 @@ void can_recover_if_needed(void) {
     }
 }
 
-bool can_update_state(car_state_t *state) {
+// Decodes one frame into the state, returns true for a BOX alert frame
+static bool can_decode_frame(car_state_t *state, const twai_message_t *msg) {
+    switch (msg->identifier) {
+        case ID_RPM: // 0x304
+            state->rpm = msg->data[0] | (msg->data[1] << 8);
+            break;
+
+        case ID_SPEED: // 0x300
+            state->speed = msg->data[0] | (msg->data[1] << 8);
+            break;
+
+        case ID_CVT_TEMP: // 0x401
+            state->cvt_temp = msg->data[0];
+            break;
+
+        case ID_VOLTAGE: // 0x502
+            memcpy(&state->voltage, msg->data, 4);
+            break;
+
+        case ID_FUEL: // 0x500
+            state->fuel = msg->data[0] | (msg->data[1] << 8);
+            break;
+        /*
+        case ID_ANGLE: // 0x205
+            state->roll  = (int16_t)(msg->data[0] | (msg->data[1] << 8));
+            state->pitch = (int16_t)(msg->data[2] | (msg->data[3] << 8));
+            break;
+        */
+        case ID_ENG_TEMP: // 0x400
+            state->eng_temp = msg->data[0];
+            break;
+
+        case ID_BOX_ALERT: { // 0x100, data[0] bit 0 = active, data[1] = box_message
+            bool active = msg->data[0] & 0x01;
+            // A newer COM ECU may send codes we have no text for
+            box_message message = msg->data[1] < BOX_UNKNOWN ? (box_message)msg->data[1] : BOX_UNKNOWN;
+            // The ECU repeats the frame, only a call going on or a new code is a new alert
+            if (active && (!state->box_alert || message != state->box_alert_message)) {
+                state->box_alert_time_us = sys_clock_us();
+            }
+            state->box_alert = active;
+            state->box_alert_message = message;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The frame is built once, and only if some hook wants it
+static void run_frame_hooks(const twai_message_t *msg, int64_t now_us) {
+    can_frame_t frame;
+    bool built = false;
+    for (int i = 0; i < CAN_FRAME_HOOKS; i++) {
+        can_frame_hook_t hook = frame_hooks[i];
+        if (!hook) continue;
+        if (!built) {
+            frame = (can_frame_t){
+                .timestamp_us = now_us,
+                .id = msg->identifier,
+                .dlc = msg->data_length_code,
+                .flags = (msg->extd ? CAN_FRAME_EXTD : 0) | (msg->rtr ? CAN_FRAME_RTR : 0),
+            };
+            memcpy(frame.data, msg->data, sizeof(frame.data));
+            built = true;
+        }
+        hook(&frame);
+    }
+}
+
+static void can_rx_task(void *arg) {
     twai_message_t msg;
-    bool updated = false;
+    car_state_t snapshot;
 
-    // Check Health First
-    can_recover_if_needed();
+    while (1) {
+        if (twai_receive(&msg, pdMS_TO_TICKS(CAN_HEALTH_PERIOD_MS)) != ESP_OK) {
+            // Quiet bus, good moment to check health
+            can_recover_if_needed();
+            continue;
+        }
 
-    // Process all incoming messages
-    while (twai_receive(&msg, 0) == ESP_OK) {
-        updated = true;
-        
-        switch (msg.identifier) {
-            case ID_RPM: // 0x304
-                state->rpm = msg.data[0] | (msg.data[1] << 8);
-                break;
-
-            case ID_SPEED: // 0x300
-                state->speed = msg.data[0] | (msg.data[1] << 8);
-                break;
-
-            case ID_CVT_TEMP: // 0x401
-                state->cvt_temp = msg.data[0];
-                break;
-
-            case ID_VOLTAGE: // 0x502
-                memcpy(&state->voltage, msg.data, 4);
-                break;
-
-            case ID_FUEL: // 0x500
-                state->fuel = msg.data[0] | (msg.data[1] << 8);
-                break;
-            /*
-            case ID_ANGLE: // 0x205
-                state->roll  = (int16_t)(msg.data[0] | (msg.data[1] << 8));
-                state->pitch = (int16_t)(msg.data[2] | (msg.data[3] << 8));
-                break;
-            */
-            case ID_ENG_TEMP: // 0x400
-                state->eng_temp = msg.data[0];
-                break;
+        // Depth before this frame was taken, checked on every frame so short bursts count
+        twai_status_info_t status;
+        uint32_t queued = twai_get_status_info(&status) == ESP_OK ? status.msgs_to_rx + 1 : 0;
+
+        int64_t now_us = sys_clock_us();
+        can_id_stats_update(msg.identifier, msg.extd, now_us);
+        run_frame_hooks(&msg, now_us);
+
+        // A busy bus never times out, sample on the clock too
+        if (now_us - last_health_us >= CAN_HEALTH_PERIOD_MS * 1000LL) can_recover_if_needed();
+
+        portENTER_CRITICAL(&rx_lock);
+        bool is_alert = can_decode_frame(&rx_state, &msg);
+        rx_dirty = true;
+        if (queued > health.rx_queued_max) health.rx_queued_max = queued;
+        if (is_alert) snapshot = rx_state;
+        portEXIT_CRITICAL(&rx_lock);
+        frames_received++;
+
+        // Fast path: hand BOX alerts to the display before draining the queue
+        can_box_alert_cb_t cb = box_alert_cb;
+        if (is_alert && cb) cb(&snapshot);
+    }
+}
+
+void can_set_box_alert_callback(can_box_alert_cb_t cb) {
+    box_alert_cb = cb;
+}
+
+bool can_add_frame_hook(can_frame_hook_t hook) {
+    bool added = false;
+    portENTER_CRITICAL(&rx_lock);
+    for (int i = 0; i < CAN_FRAME_HOOKS && !added; i++) {
+        if (!frame_hooks[i]) {
+            frame_hooks[i] = hook;
+            added = true;
         }
     }
+    portEXIT_CRITICAL(&rx_lock);
+    return added;
+}
+
+void can_remove_frame_hook(can_frame_hook_t hook) {
+    portENTER_CRITICAL(&rx_lock);
+    for (int i = 0; i < CAN_FRAME_HOOKS; i++) {
+        if (frame_hooks[i] == hook) frame_hooks[i] = NULL;
+    }
+    portEXIT_CRITICAL(&rx_lock);
+}
+
+void can_init(void) {
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(CAN_TX_PIN, CAN_RX_PIN,
+                                        CAN_SELF_TEST ? TWAI_MODE_NO_ACK : TWAI_MODE_NORMAL);
+    g_config.rx_queue_len = CAN_RX_QUEUE_LEN;
+    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
+    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+
+    can_id_stats_init();
+
+    // Install and start, always checking for errors
+    if (twai_driver_install(&g_config, &t_config, &f_config) == ESP_OK) {
+        ESP_LOGI(TAG, "Driver installed");
+    }
+    if (twai_start() == ESP_OK) {
+        ESP_LOGI(TAG, "Driver started");
+    }
+    // First sample now, files opened before the RX task gets to it see it
+    twai_status_info_t status;
+    if (twai_get_status_info(&status) == ESP_OK) can_sample_health(&status);
+
+    xTaskCreatePinnedToCore(can_rx_task, "can_rx", CAN_TASK_STACK, NULL,
+                            CAN_TASK_PRIORITY, NULL, CAN_TASK_CORE);
+    can_tx_init();
+}
+
+bool can_update_state(car_state_t *state) {
+    bool updated = false;
+
+    portENTER_CRITICAL(&rx_lock);
+    if (rx_dirty) {
+        // The link flag belongs to the caller
+        bool link_active = state->link_active;
+        *state = rx_state;
+        state->link_active = link_active;
+        rx_dirty = false;
+        updated = true;
+    }
+    portEXIT_CRITICAL(&rx_lock);
+
     return updated;
 }
+
+uint32_t can_bus_off_count(void) {
+    return bus_off_count;
+}
+
+void can_get_health(can_health_t *out) {
+    portENTER_CRITICAL(&rx_lock);
+    *out = health;
+    portEXIT_CRITICAL(&rx_lock);
+    out->bus_off = bus_off_count;
+}
+
+uint32_t can_frames_received(void) {
+    return frames_received;
+}
@@ -0,0 +1,225 @@
+#include <string.h>
+#include "can_tx.h"
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sys_clock.h"
+
+#define TAG "CAN_TX"
+#define TOKEN       1000000LL   // One frame of budget, in frame-microseconds
+
+// Most urgent first, the order frames go out in
+typedef enum {
+    TX_EMERGENCY,
+    TX_REQUEST,
+    TX_STATUS,
+    TX_KIND_COUNT,
+} tx_kind_t;
+
+// What callers leave for the TX task
+static struct {
+    uint8_t emergency;
+    bool emergency_changed;
+    uint8_t request;
+    uint8_t mode;
+    uint8_t status;
+} pending;
+static can_tx_stats_t stats;
+static portMUX_TYPE tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t tx_task = NULL;
+
+// TX task only
+static int64_t next_status_us;
+static int64_t next_emergency_us;
+static uint8_t counters[TX_KIND_COUNT];
+
+static void poke(void)
+{
+    TaskHandle_t t = tx_task;
+    if (t) xTaskNotifyGive(t);
+}
+
+static bool is_due(tx_kind_t kind, int64_t now_us)
+{
+    switch (kind) {
+        case TX_EMERGENCY:
+            return pending.emergency_changed || (pending.emergency && now_us >= next_emergency_us);
+        case TX_REQUEST:
+            return pending.request != 0;
+        case TX_STATUS:
+            return now_us >= next_status_us;
+        default:
+            return false;
+    }
+}
+
+// Snapshot of the pending bits as a frame. Caller holds tx_lock
+static void build(tx_kind_t kind, twai_message_t *msg)
+{
+    memset(msg, 0, sizeof(*msg));
+    switch (kind) {
+        case TX_EMERGENCY:
+            msg->identifier = ID_WHEEL_EMERGENCY;
+            msg->data_length_code = 2;
+            msg->data[0] = pending.emergency;
+            msg->data[1] = counters[kind];
+            msg->ss = 1;        // Repeated anyway, a lost one is not retried
+            break;
+        case TX_REQUEST:
+            msg->identifier = ID_WHEEL_REQUEST;
+            msg->data_length_code = 2;
+            msg->data[0] = pending.request;
+            msg->data[1] = counters[kind];
+            break;
+        default:
+            msg->identifier = ID_WHEEL_STATUS;
+            msg->data_length_code = 4;
+            msg->data[0] = counters[kind];
+            msg->data[1] = pending.mode;
+            msg->data[2] = pending.status;
+            msg->data[3] = pending.emergency;
+            msg->ss = 1;        // A late heartbeat is worse than none
+            break;
+    }
+}
+
+// The frame made it to the driver: what it carried is no longer pending
+static void sent(tx_kind_t kind, const twai_message_t *msg, int64_t now_us)
+{
+    counters[kind]++;
+    switch (kind) {
+        case TX_EMERGENCY:
+            pending.emergency_changed = false;
+            next_emergency_us = now_us + CAN_TX_EMERGENCY_MS * 1000LL;
+            stats.emergency_sent++;
+            break;
+        case TX_REQUEST:
+            pending.request &= ~msg->data[0];
+            stats.request_sent++;
+            break;
+        default:
+            next_status_us = now_us + CAN_TX_STATUS_MS * 1000LL;
+            stats.status_sent++;
+            break;
+    }
+}
+
+static void can_tx_task(void *arg)
+{
+    int64_t tokens = CAN_TX_BURST * TOKEN;
+    int64_t last_us = sys_clock_us();
+    int64_t window_us = last_us;
+    uint32_t window_frames = 0;
+    next_status_us = last_us;
+
+    while (1) {
+        int64_t now_us = sys_clock_us();
+        tokens += (now_us - last_us) * CAN_TX_RATE_MAX;
+        if (tokens > CAN_TX_BURST * TOKEN) tokens = CAN_TX_BURST * TOKEN;
+        last_us = now_us;
+
+        if (now_us - window_us >= 1000000) {
+            portENTER_CRITICAL(&tx_lock);
+            stats.rate = window_frames;
+            if (window_frames > stats.rate_max) stats.rate_max = window_frames;
+            portEXIT_CRITICAL(&tx_lock);
+            window_frames = 0;
+            window_us = now_us;
+        }
+
+        bool starved = false;
+        bool bus_down = false;
+        for (tx_kind_t kind = 0; kind < TX_KIND_COUNT; kind++) {
+            twai_message_t msg;
+            portENTER_CRITICAL(&tx_lock);
+            bool due = is_due(kind, now_us);
+            if (due && tokens < TOKEN) stats.deferred++;
+            else if (due) build(kind, &msg);
+            portEXIT_CRITICAL(&tx_lock);
+            if (!due) continue;
+            if (tokens < TOKEN) {
+                starved = true;
+                break;
+            }
+
+            // Never waits: a full queue keeps the bits pending for next time
+            esp_err_t err = twai_transmit(&msg, 0);
+            if (err != ESP_OK) {
+                portENTER_CRITICAL(&tx_lock);
+                stats.refused++;
+                portEXIT_CRITICAL(&tx_lock);
+                starved = true;
+                // Bus-off or stopped: nothing goes out until the RX task recovers it
+                bus_down = (err == ESP_ERR_INVALID_STATE);
+                break;
+            }
+            tokens -= TOKEN;
+            window_frames++;
+            portENTER_CRITICAL(&tx_lock);
+            sent(kind, &msg, now_us);
+            portEXIT_CRITICAL(&tx_lock);
+        }
+
+        // Sleep until the next periodic frame, or until budget or queue
+        // room may be back; a caller's poke cuts it short
+        int64_t wake_us = next_status_us;
+        portENTER_CRITICAL(&tx_lock);
+        if (pending.emergency && next_emergency_us < wake_us) wake_us = next_emergency_us;
+        portEXIT_CRITICAL(&tx_lock);
+        if (bus_down) {
+            // Whatever is due would fail too, retry at the recovery pace
+            wake_us = now_us + CAN_HEALTH_PERIOD_MS * 1000LL;
+        } else if (starved) {
+            int64_t budget_us = now_us + (TOKEN - tokens + CAN_TX_RATE_MAX - 1) / CAN_TX_RATE_MAX;
+            if (budget_us < wake_us) wake_us = budget_us;
+        }
+        int64_t wait_ms = (wake_us - sys_clock_us() + 999) / 1000;
+        if (wait_ms < (int64_t)portTICK_PERIOD_MS) wait_ms = portTICK_PERIOD_MS;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+    }
+}
+
+void can_tx_init(void)
+{
+    if (tx_task) return;
+    if (xTaskCreatePinnedToCore(can_tx_task, "can_tx", CAN_TX_TASK_STACK, NULL,
+                                CAN_TX_TASK_PRIORITY, &tx_task, CAN_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start TX task");
+    }
+}
+
+void can_tx_emergency(uint8_t flags, bool active)
+{
+    portENTER_CRITICAL(&tx_lock);
+    uint8_t was = pending.emergency;
+    if (active) pending.emergency |= flags;
+    else pending.emergency &= ~flags;
+    bool changed = pending.emergency != was;
+    if (changed) pending.emergency_changed = true;
+    portEXIT_CRITICAL(&tx_lock);
+    if (changed) poke();
+}
+
+void can_tx_request(uint8_t flags)
+{
+    portENTER_CRITICAL(&tx_lock);
+    pending.request |= flags;
+    portEXIT_CRITICAL(&tx_lock);
+    poke();
+}
+
+void can_tx_set_status(uint8_t mode, uint8_t flags)
+{
+    portENTER_CRITICAL(&tx_lock);
+    pending.mode = mode;
+    pending.status = flags;
+    portEXIT_CRITICAL(&tx_lock);
+}
+
+void can_tx_get_stats(can_tx_stats_t *out)
+{
+    portENTER_CRITICAL(&tx_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&tx_lock);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_management.h"
+
+// --- PER ID TRAFFIC ---
+// Every received frame updates its ID's entry in a fixed table (open
+// addressing, O(1) per frame in the CAN task). A flaky ECU shows up as an
+// ID going missing or drifting off its period, on the wheel and in the
+// STN.TXT the logger writes.
+#define CAN_ID_STATS_LEN        32      // Power of two, IDs past it are only counted
+#define CAN_ID_EXTD             0x80000000  // Set in can_id_stat_t.id for 29 bit IDs
+#define CAN_ID_AVG_SHIFT        4       // Recent interval and jitter average over ~16 frames
+#define CAN_ID_MISSING_PERIODS  5       // Silent this many periods = missing
+#define CAN_ID_PERIOD_TOL_PCT   25      // Recent interval this far off = off period
+
+// What the ECUs are set up to send, period in ms. Listed IDs are in the
+// table from boot, so one that never shows up is reported missing too
+#define CAN_ID_EXPECTED {                                                       \
+        { ID_RPM, 10 }, { ID_SPEED, 10 }, { ID_ENG_TEMP, 100 },                 \
+        { ID_CVT_TEMP, 100 }, { ID_FUEL, 100 }, { ID_VOLTAGE, 100 },            \
+    }
+
+typedef struct {
+    uint32_t id;            // CAN_ID_EXTD for 29 bit
+    uint16_t expected_ms;   // 0 = not in CAN_ID_EXPECTED
+    uint32_t count;
+    int64_t first_us;       // sys_clock time of the first and last frame
+    int64_t last_us;
+    uint32_t avg_us;        // Recent inter-arrival interval
+    uint32_t max_us;        // Longest interval since boot
+    uint32_t jitter_us;     // Recent mean deviation from avg_us
+} can_id_stat_t;
+
+typedef enum {
+    CAN_ID_OK,
+    CAN_ID_MISSING,         // Never seen, or silent for CAN_ID_MISSING_PERIODS
+    CAN_ID_OFF_PERIOD,      // Recent interval out of CAN_ID_PERIOD_TOL_PCT
+} can_id_status_t;
+
+// Called by can_init() and the CAN task
+void can_id_stats_init(void);
+void can_id_stats_update(uint32_t id, bool extd, int64_t now_us);
+
+// Copies the entries in use, sorted by ID, up to max. Returns how many
+int can_id_stats_get(can_id_stat_t *out, int max);
+// Frames whose ID found the table full
+uint32_t can_id_stats_overflow(void);
+can_id_status_t can_id_check(const can_id_stat_t *e, int64_t now_us);
+
+// Interval over the whole session, 0 before the second frame
+static inline uint32_t can_id_mean_us(const can_id_stat_t *e)
+{
+    return e->count > 1 ? (uint32_t)((e->last_us - e->first_us) / (e->count - 1)) : 0;
+}
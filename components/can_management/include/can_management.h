@@ -10,11 +10,38 @@
 #define ID_ENG_TEMP     0x400
 #define ID_VOLTAGE      0x502
 #define ID_FUEL         0x500
+#define ID_BOX_ALERT    0x100  // COM ECU pit-to-pilot alert, low ID so it wins arbitration
+
+// --- Sent by the wheel (layouts in can_tx.h) ---
+#define ID_WHEEL_EMERGENCY  0x0F0  // Ahead of everything, BOX alerts included
+#define ID_WHEEL_REQUEST    0x110  // Pilot to box, right behind the BOX alert
+#define ID_WHEEL_STATUS     0x610  // Heartbeat, low priority
+
+// How long the RX task blocks before checking bus health, and how often
+// it samples can_health_t on a busy bus
+#define CAN_HEALTH_PERIOD_MS    100
+
+// RX task placement, everything else (render, logging) stays off this core
+#define CAN_TASK_CORE       1
+#define CAN_TASK_PRIORITY   10
+#define CAN_TASK_STACK      4096
+// TWAI driver RX queue, frames waiting for the RX task (driver default 5)
+#define CAN_RX_QUEUE_LEN    5
+// Frame hooks that can be registered at once: the SD capture and a bench tool
+#define CAN_FRAME_HOOKS     2
+
+// Bench builds: no-ACK mode, so frames sent with self reception come back
+// through the RX queue without another node on the bus (see can_replay.h).
+// Never on the car, a lone node would not notice its frames going nowhere
+#ifndef CAN_SELF_TEST
+#define CAN_SELF_TEST       0
+#endif
 
 typedef enum {
     CVT,
     BAT,
     FUEL,
+    BOX_UNKNOWN,    // Code this firmware does not know, the call still shows
 } box_message;
 
 // --- Data Structure for the Dashboard ---
@@ -30,9 +57,61 @@ typedef struct {
     bool link_active;   // Safety flag
     bool box_alert;
     box_message box_alert_message;
+    int64_t box_alert_time_us;  // sys_clock time the call went on or changed code
 } car_state_t;
 
+// TWAI controller health, sampled by the RX task every CAN_HEALTH_PERIOD_MS
+// (and whenever the bus goes quiet). Driver counters are totals since boot
+typedef struct {
+    uint32_t samples;
+    uint8_t state;              // twai_state_t at the last sample
+    uint32_t tx_err;            // Error counters at the last sample
+    uint32_t rx_err;
+    uint32_t tx_err_max;        // Highest seen, >= 128 means error passive was hit
+    uint32_t rx_err_max;
+    uint32_t rx_queued;         // msgs_to_rx at the last sample
+    uint32_t rx_queued_max;     // of CAN_RX_QUEUE_LEN, checked on every frame
+    uint32_t tx_queued_max;
+    uint32_t rx_missed;         // RX queue full, frame lost
+    uint32_t rx_overrun;        // Controller FIFO overrun, frame lost
+    uint32_t arb_lost;
+    uint32_t bus_error;
+    uint32_t tx_failed;
+    uint32_t bus_off;           // Bus-off events, each one recovered
+} can_health_t;
+
+// Raw frame as received, for capture and replay
+#define CAN_FRAME_EXTD  0x01    // 29 bit identifier
+#define CAN_FRAME_RTR   0x02    // Remote frame, no payload
+
+typedef struct {
+    int64_t timestamp_us;   // sys_clock time of reception
+    uint32_t id;
+    uint8_t dlc;
+    uint8_t flags;          // CAN_FRAME_*
+    uint8_t data[8];
+} can_frame_t;
+
+// Called from the CAN task for every received frame, before decoding
+// Must be wait-free: anything slow here delays decoding
+typedef void (*can_frame_hook_t)(const can_frame_t *frame);
+
+// Called from the CAN task as soon as a BOX alert frame is decoded
+// Keep it short: it runs ahead of the rest of the RX queue
+typedef void (*can_box_alert_cb_t)(const car_state_t *state);
+
+// Register before can_init() so no alert frame can be missed
+void can_set_box_alert_callback(can_box_alert_cb_t cb);
+// Every hook sees every frame. false if all CAN_FRAME_HOOKS are taken
+bool can_add_frame_hook(can_frame_hook_t hook);
+void can_remove_frame_hook(can_frame_hook_t hook);
+// Installs the driver and starts the RX task pinned to CAN_TASK_CORE
 void can_init(void);
-// Updates the state struct based on whatever messages are in the buffer
-// Returns true if ANY data was updated
+// Copies the state decoded by the RX task into the caller's struct
+// Returns true if ANY data was updated since the last call
 bool can_update_state(car_state_t *state);
+// Bus-off events since boot, each one was recovered by the RX task
+uint32_t can_bus_off_count(void);
+void can_get_health(can_health_t *health);
+// Frames taken off the RX queue and decoded since boot
+uint32_t can_frames_received(void);
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_management.h"
+
+// --- TX SCHEDULER ---
+// The wheel's only sender. Callers set bits under a spinlock and poke the
+// TX task, they never wait on the driver. The task packs whatever is
+// pending into one frame per ID, most urgent first, and hands it over with
+// twai_transmit(..., 0) within a frame rate budget. Flags raised while a
+// frame waits for budget or queue room go out in that same frame.
+#define CAN_TX_TASK_PRIORITY    (CAN_TASK_PRIORITY - 1)   // RX comes first
+#define CAN_TX_TASK_STACK       3072
+#define CAN_TX_STATUS_MS        200     // Heartbeat period
+#define CAN_TX_EMERGENCY_MS     100     // Repeat period while an emergency is up
+#define CAN_TX_RATE_MAX         50      // Frames/s over time (token bucket)
+#define CAN_TX_BURST            4       // Frames that may go back to back
+
+// ID_WHEEL_EMERGENCY: data[0] flags, data[1] counter. Held until cleared,
+// repeated while any is up, one last frame when the last one clears
+#define CAN_EMERG_NO_LINK       0x01    // No data from the car for TIMEOUT_MS
+#define CAN_EMERG_NO_RADIO      0x02    // Radio down
+// ID_WHEEL_REQUEST: data[0] flags, data[1] counter. Each raised flag is
+// sent once, the counter tells a repeat from a new request
+#define CAN_REQ_BOX             0x01    // Pilot asks to come in
+#define CAN_REQ_ALERT_SEEN      0x02    // A BOX alert reached the screen
+// ID_WHEEL_STATUS: data[0] counter, data[1] screen mode, data[2] flags,
+// data[3] emergency flags
+#define CAN_STATUS_LINK         0x01    // Car data coming in
+#define CAN_STATUS_SD_LOGGING   0x02
+
+typedef struct {
+    uint32_t emergency_sent;
+    uint32_t request_sent;
+    uint32_t status_sent;
+    uint32_t deferred;      // Due frames held back by the rate budget
+    uint32_t refused;       // Driver queue full or controller down, retried later
+    uint32_t rate;          // Frames sent in the last full second
+    uint32_t rate_max;
+} can_tx_stats_t;
+
+// Started by can_init()
+void can_tx_init(void);
+// Raises (active) or clears emergency flags
+void can_tx_emergency(uint8_t flags, bool active);
+void can_tx_request(uint8_t flags);
+// Heartbeat content, cheap enough to call every frame
+void can_tx_set_status(uint8_t mode, uint8_t flags);
+void can_tx_get_stats(can_tx_stats_t *stats);
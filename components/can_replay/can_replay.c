@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include "can_replay.h"
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sys_clock.h"
+#include "sd_logging.h"
+
+#define TAG "CAN_REPLAY"
+
+static can_replay_src_t src;    // Holds a block buffer, too big for the stack
+static float replay_speed;
+static can_replay_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void send_frame(const can_frame_t *frame)
+{
+    twai_message_t msg = {
+        .identifier = frame->id,
+        .data_length_code = frame->dlc,
+        .extd = (frame->flags & CAN_FRAME_EXTD) ? 1 : 0,
+        .rtr = (frame->flags & CAN_FRAME_RTR) ? 1 : 0,
+        .self = 1,
+    };
+    memcpy(msg.data, frame->data, sizeof(msg.data));
+    esp_err_t err = twai_transmit(&msg, pdMS_TO_TICKS(CAN_REPLAY_TX_TIMEOUT_MS));
+
+    portENTER_CRITICAL(&stats_lock);
+    if (err == ESP_OK) stats.frames_sent++;
+    else stats.tx_errors++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void update_progress(uint32_t decoded_at_start, int64_t start_us)
+{
+    portENTER_CRITICAL(&stats_lock);
+    stats.frames_decoded = can_frames_received() - decoded_at_start;
+    stats.elapsed_us = sys_clock_us() - start_us;
+    stats.skipped = src.skipped;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void can_replay_task(void *arg)
+{
+    can_frame_t frame;
+    int64_t first_us = 0;
+    int64_t start_us = 0;
+    uint32_t decoded_at_start = can_frames_received();
+    bool first = true;
+
+    while (can_replay_src_next(&src, &frame)) {
+        if (first) {
+            first_us = frame.timestamp_us;
+            start_us = sys_clock_us();
+            first = false;
+        }
+        if (replay_speed > 0) {
+            // Whole ticks only, whatever is due within one goes out now
+            int64_t due = start_us + (int64_t)((frame.timestamp_us - first_us) / replay_speed);
+            int64_t wait_ms = (due - sys_clock_us()) / 1000;
+            if (wait_ms >= portTICK_PERIOD_MS) sys_clock_delay_ms(wait_ms);
+        }
+        send_frame(&frame);
+        update_progress(decoded_at_start, start_us);
+    }
+
+    // Frames still in the TX and RX queues count once the CAN task has them
+    for (int waited = 0; waited < CAN_REPLAY_DRAIN_MS; waited += portTICK_PERIOD_MS) {
+        if (can_frames_received() - decoded_at_start >= stats.frames_sent) break;
+        sys_clock_delay_ms(portTICK_PERIOD_MS);
+    }
+    can_replay_src_close(&src);
+    if (!first) update_progress(decoded_at_start, start_us);
+
+    portENTER_CRITICAL(&stats_lock);
+    can_replay_stats_t st = stats;
+    stats.running = false;
+    portEXIT_CRITICAL(&stats_lock);
+
+    int64_t ms = st.elapsed_us / 1000;
+    ESP_LOGI(TAG, "Replayed %lu frames in %lld ms: %llu frames/s sent, %llu frames/s decoded",
+             st.frames_sent, ms, ms ? st.frames_sent * 1000ULL / ms : 0, ms ? st.frames_decoded * 1000ULL / ms : 0);
+    if (st.tx_errors || st.skipped || st.frames_decoded != st.frames_sent) {
+        ESP_LOGW(TAG, "%lu TX errors, %lu decoded of %lu sent, %lu bad blocks or lines skipped",
+                 st.tx_errors, st.frames_decoded, st.frames_sent, st.skipped);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t can_replay_start(const char *path, float speed)
+{
+    if (!CAN_SELF_TEST) {
+        ESP_LOGE(TAG, "Replay needs CAN_SELF_TEST, frames would not come back");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (stats.running) return ESP_ERR_INVALID_STATE;
+    if (!can_replay_src_open(&src, path)) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return ESP_FAIL;
+    }
+    static const char *format_names[] = { "raw capture", "candump", "ASC" };
+    if (speed > 0) ESP_LOGI(TAG, "Replaying %s (%s) at %.1fx", path, format_names[src.format], speed);
+    else ESP_LOGI(TAG, "Replaying %s (%s) as fast as the bus takes it", path, format_names[src.format]);
+
+    memset(&stats, 0, sizeof(stats));
+    stats.running = true;
+    replay_speed = speed;
+    if (xTaskCreatePinnedToCore(can_replay_task, "can_replay", CAN_REPLAY_TASK_STACK, NULL,
+                                CAN_REPLAY_TASK_PRIORITY, NULL, CAN_REPLAY_TASK_CORE) != pdPASS) {
+        can_replay_src_close(&src);
+        stats.running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_replay_from_card(void)
+{
+    if (!CAN_SELF_TEST) return ESP_ERR_NOT_SUPPORTED;
+
+    static const char *names[] = CAN_REPLAY_NAMES;
+    char path[32];
+    FILE *f = NULL;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && !f; i++) {
+        snprintf(path, sizeof(path), MOUNT_POINT "/%s", names[i]);
+        f = fopen(path, "rb");
+    }
+    if (!f) return ESP_ERR_NOT_FOUND;
+    fclose(f);
+
+    float speed = CAN_REPLAY_SPEED;
+    FILE *cfg = fopen(MOUNT_POINT "/" CAN_REPLAY_CONFIG, "r");
+    if (cfg) {
+        float s;
+        if (fscanf(cfg, " speed %f", &s) == 1 && s >= 0) speed = s;
+        fclose(cfg);
+    }
+    return can_replay_start(path, speed);
+}
+
+void can_replay_get_stats(can_replay_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "can_replay.h"
+
+#define LINE_LEN    160
+
+static bool bcan_header_ok(const uint8_t *block)
+{
+    blog_file_header_t hdr;
+    memcpy(&hdr, block, sizeof(hdr));
+    return memcmp(hdr.magic, BCAN_MAGIC, sizeof(hdr.magic)) == 0 && hdr.version == BCAN_VERSION &&
+           hdr.block_size == BLOG_BLOCK_SIZE && hdr.record_size == sizeof(bcan_record_t);
+}
+
+bool can_replay_src_open(can_replay_src_t *src, const char *path)
+{
+    memset(src, 0, sizeof(*src));
+    src->f = fopen(path, "rb");
+    if (!src->f) return false;
+
+    if (fread(src->block, 1, BLOG_BLOCK_SIZE, src->f) == BLOG_BLOCK_SIZE && bcan_header_ok(src->block)) {
+        blog_file_header_t hdr;
+        memcpy(&hdr, src->block, sizeof(hdr));
+        src->format = CAN_REPLAY_BCAN;
+        src->session = hdr.session;
+        src->closed = hdr.flags & BLOG_FLAG_CLOSED;
+        return true;
+    }
+
+    // Text: the first line that is not blank or a comment tells which
+    rewind(src->f);
+    char line[LINE_LEN];
+    while (fgets(line, sizeof(line), src->f)) {
+        const char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+        src->format = (*p == '(') ? CAN_REPLAY_CANDUMP : CAN_REPLAY_ASC;
+        break;
+    }
+    rewind(src->f);
+    return true;
+}
+
+void can_replay_src_close(can_replay_src_t *src)
+{
+    if (src->f) fclose(src->f);
+    src->f = NULL;
+}
+
+static bool next_bcan(can_replay_src_t *src, can_frame_t *frame)
+{
+    for (;;) {
+        while (src->index < src->count) {
+            bcan_record_t r;
+            memcpy(&r, src->block + sizeof(blog_block_header_t) + src->index++ * sizeof(r), sizeof(r));
+            if (r.can_id & BCAN_ERR_FLAG) continue;     // Drop and event markers
+            frame->timestamp_us = (int64_t)r.timestamp_us;
+            frame->id = r.can_id & ((r.can_id & BCAN_EFF_FLAG) ? 0x1FFFFFFF : 0x7FF);
+            frame->dlc = r.len > 8 ? 8 : r.len;
+            frame->flags = ((r.can_id & BCAN_EFF_FLAG) ? CAN_FRAME_EXTD : 0) |
+                           ((r.can_id & BCAN_RTR_FLAG) ? CAN_FRAME_RTR : 0);
+            memcpy(frame->data, r.data, sizeof(frame->data));
+            return true;
+        }
+        if (fread(src->block, 1, BLOG_BLOCK_SIZE, src->f) != BLOG_BLOCK_SIZE) return false;
+        if (!blog_block_in_sequence(src->block, src->session, src->seq++)) {
+            // A closed file was cut to its length, a bad block is damage.
+            // Otherwise the valid blocks are a prefix: this is the end
+            if (!src->closed) return false;
+            src->skipped++;
+            continue;
+        }
+        blog_block_header_t bh;
+        memcpy(&bh, src->block, sizeof(bh));
+        src->index = 0;
+        src->count = bh.record_count < BCAN_RECORDS_PER_BLOCK ? bh.record_count : BCAN_RECORDS_PER_BLOCK;
+    }
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "(1234.567890) can0 304#A20A", "... 1ABCDEF0#", "... 304#R"
+static bool parse_candump(const char *line, can_frame_t *frame)
+{
+    char *end;
+    if (*line != '(') return false;
+    unsigned long long sec = strtoull(line + 1, &end, 10);
+    if (*end != '.') return false;
+    const char *frac = end + 1;
+    unsigned long long usec = strtoull(frac, &end, 10);
+    if (*end != ')' || end - frac != 6) return false;
+
+    const char *p = end + 1;
+    while (*p == ' ') p++;
+    while (*p && *p != ' ') p++;                // Interface name
+    while (*p == ' ') p++;
+
+    const char *id_start = p;
+    unsigned long id = strtoul(p, &end, 16);
+    if (*end != '#' || end == id_start || end[1] == '#') return false;     // CAN FD has ##
+    memset(frame, 0, sizeof(*frame));
+    frame->timestamp_us = (int64_t)(sec * 1000000ULL + usec);
+    frame->id = (uint32_t)id;
+    if (end - id_start == 8) frame->flags |= CAN_FRAME_EXTD;
+
+    p = end + 1;
+    if (*p == 'R') {
+        frame->flags |= CAN_FRAME_RTR;
+        return true;
+    }
+    while (frame->dlc < 8) {
+        int hi = hex_digit(p[0]);
+        int lo = hi < 0 ? -1 : hex_digit(p[1]);
+        if (lo < 0) break;
+        frame->data[frame->dlc++] = (uint8_t)(hi << 4 | lo);
+        p += 2;
+    }
+    return true;
+}
+
+// "   0.123456 1  304             Rx   d 2 A2 0A", extended IDs end in x
+static bool parse_asc(const char *line, bool dec, can_frame_t *frame)
+{
+    char *end;
+    double t = strtod(line, &end);
+    if (end == line) return false;
+    const char *p = end;
+    unsigned long channel = strtoul(p, &end, 10);
+    if (end == p || channel == 0) return false;
+
+    p = end;
+    while (*p == ' ') p++;
+    const char *id_start = p;
+    unsigned long id = strtoul(p, &end, dec ? 10 : 16);
+    if (end == id_start) return false;
+    memset(frame, 0, sizeof(*frame));
+    if (*end == 'x') {
+        frame->flags |= CAN_FRAME_EXTD;
+        end++;
+    }
+    frame->id = (uint32_t)id;
+    frame->timestamp_us = (int64_t)(t * 1e6 + 0.5);
+
+    char dir[4], kind[4];
+    int used = 0;
+    if (sscanf(end, " %3s %3s%n", dir, kind, &used) != 2) return false;
+    if (strcmp(dir, "Rx") != 0 && strcmp(dir, "Tx") != 0) return false;
+    if (strcmp(kind, "r") == 0) {
+        frame->flags |= CAN_FRAME_RTR;
+        return true;
+    }
+    if (strcmp(kind, "d") != 0) return false;
+
+    p = end + used;
+    unsigned long dlc = strtoul(p, &end, 16);
+    if (end == p || dlc > 8) return false;
+    for (unsigned long i = 0; i < dlc; i++) {
+        p = end;
+        unsigned long b = strtoul(p, &end, 16);
+        if (end == p) return false;
+        frame->data[i] = (uint8_t)b;
+    }
+    frame->dlc = (uint8_t)dlc;
+    return true;
+}
+
+static bool next_text(can_replay_src_t *src, can_frame_t *frame)
+{
+    char line[LINE_LEN];
+    while (fgets(line, sizeof(line), src->f)) {
+        const char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (src->format == CAN_REPLAY_CANDUMP) {
+            if (*p != '(') continue;        // Blank lines, # comments
+            if (parse_candump(p, frame)) return true;
+        } else {
+            // Header lines, comments and events don't start with a time
+            if (strncmp(p, "base dec", 8) == 0) src->asc_dec = true;
+            if (!isdigit((unsigned char)*p)) continue;
+            if (parse_asc(p, src->asc_dec, frame)) return true;
+            // Error frames, statistics and the like carry a time as well
+            if (strstr(p, " Rx ") == NULL && strstr(p, " Tx ") == NULL) continue;
+        }
+        src->skipped++;
+    }
+    return false;
+}
+
+bool can_replay_src_next(can_replay_src_t *src, can_frame_t *frame)
+{
+    if (!src->f) return false;
+    if (src->format == CAN_REPLAY_BCAN) return next_bcan(src, frame);
+    return next_text(src, frame);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "log_format.h"
+#include "can_management.h"
+
+// --- CAN REPLAY ---
+// Plays recorded traffic back into the CAN layer, to reproduce on the bench
+// what happened on track. Frames go out on the controller with self
+// reception and come back through the RX queue, so the driver, decoding,
+// can_update_state() and the logger see them like live traffic. Needs
+// CAN_SELF_TEST (can_management.h), the simulator builds with it.
+#define CAN_REPLAY_NAMES        { "replay.bin", "replay.log", "replay.asc" }   // On the card, first found
+#define CAN_REPLAY_CONFIG       "replay.cfg"    // Optional: "speed 10", "speed 0" = as fast as possible
+#define CAN_REPLAY_SPEED        1.0f            // Default: recorded timing
+#define CAN_REPLAY_TASK_CORE    (1 - CAN_TASK_CORE)
+#define CAN_REPLAY_TASK_PRIORITY 5
+#define CAN_REPLAY_TASK_STACK   4096
+#define CAN_REPLAY_TX_TIMEOUT_MS 100            // A full TX queue for this long counts as an error
+#define CAN_REPLAY_DRAIN_MS     200             // Wait for the last frames to come back
+
+// Capture formats, told apart by content
+typedef enum {
+    CAN_REPLAY_BCAN,        // Our raw capture, can_N.bin or EN/EVM.BIN
+    CAN_REPLAY_CANDUMP,     // candump -l: "(sec.usec) iface ID#DATA"
+    CAN_REPLAY_ASC,         // Vector ASCII, what can_export -f asc writes
+} can_replay_format_t;
+
+// Reads frames out of a capture, one at a time. Plain C and stdio, the
+// host tools use it too
+typedef struct {
+    FILE *f;
+    can_replay_format_t format;
+    bool asc_dec;               // ASC with "base dec" IDs
+    uint32_t session;           // BCAN: file header session
+    bool closed;                // BCAN: BLOG_FLAG_CLOSED
+    uint32_t seq;               // BCAN: next block number
+    uint16_t index;             // BCAN: next record in the block
+    uint16_t count;             // BCAN: records in the block
+    uint32_t skipped;           // Bad blocks, lines that looked like frames but were not
+    uint8_t block[BLOG_BLOCK_SIZE];
+} can_replay_src_t;
+
+bool can_replay_src_open(can_replay_src_t *src, const char *path);
+// Next bus frame, timestamp as recorded (ASC: from the start of the log).
+// Markers and comments are skipped. false at the end of the file
+bool can_replay_src_next(can_replay_src_t *src, can_frame_t *frame);
+void can_replay_src_close(can_replay_src_t *src);
+
+typedef struct {
+    bool running;
+    uint32_t frames_sent;
+    uint32_t frames_decoded;    // Taken off the RX queue by the CAN task meanwhile
+    uint32_t tx_errors;
+    uint32_t skipped;           // See can_replay_src_t
+    int64_t elapsed_us;         // First frame sent to last frame decoded
+} can_replay_stats_t;
+
+// Replays path in its own task. speed 1 = recorded timing, 10 = ten times
+// faster, 0 = as fast as the bus takes them. Timing is kept to the tick,
+// frames due within one go out back to back
+esp_err_t can_replay_start(const char *path, float speed);
+// Starts the first CAN_REPLAY_NAMES file on the card, if there is one.
+// ESP_ERR_NOT_FOUND without one, ESP_ERR_NOT_SUPPORTED without CAN_SELF_TEST
+esp_err_t can_replay_from_card(void);
+void can_replay_get_stats(can_replay_stats_t *stats);
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "can_stress.h"
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sys_clock.h"
+#include "sd_logging.h"
+
+#define TAG "CAN_STRESS"
+#define LINE_LEN    128
+#define TEXT_LEN    512
+
+static can_stress_profile_t profile;
+static can_stress_step_t results[CAN_STRESS_MAX_STEPS];
+static int steps_done;
+static volatile bool running;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// What the CAN task saw of the current step
+static struct {
+    bool active;
+    uint32_t start_us;          // Step start, low 32 bits like the stamps
+    uint32_t received;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+} probe;
+
+// Nominal bits with IFS, no stuff bits: what the loads are counted in
+static uint32_t frame_bits(const can_stress_id_t *e)
+{
+    return (e->id > 0x7FF ? 67 : 47) + 8 * e->dlc;
+}
+
+static bool in_mix(const can_frame_t *frame)
+{
+    for (int i = 0; i < profile.id_count; i++) {
+        if (profile.ids[i].id == frame->id &&
+            (profile.ids[i].id > 0x7FF) == ((frame->flags & CAN_FRAME_EXTD) != 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// CAN task
+static void probe_hook(const can_frame_t *frame)
+{
+    if (!probe.active || frame->dlc < 4 || !in_mix(frame)) return;
+    uint32_t sent_us;
+    memcpy(&sent_us, frame->data, sizeof(sent_us));
+    uint32_t latency = (uint32_t)frame->timestamp_us - sent_us;
+    // The default mix shares IDs with the car's ECUs: one of theirs on the
+    // bench bus only counts if its first bytes read as a send time in this step
+    if (sent_us - probe.start_us > (uint32_t)frame->timestamp_us - probe.start_us) return;
+
+    portENTER_CRITICAL(&lock);
+    probe.received++;
+    probe.latency_sum_us += latency;
+    if (latency > probe.latency_max_us) probe.latency_max_us = latency;
+    portEXIT_CRITICAL(&lock);
+}
+
+static uint32_t probe_received(void)
+{
+    portENTER_CRITICAL(&lock);
+    uint32_t n = probe.received;
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+// Smooth weighted round robin: the mix is spread evenly and repeatably
+static const can_stress_id_t *next_id(int *credit, int total_weight)
+{
+    int best = 0;
+    for (int i = 0; i < profile.id_count; i++) {
+        credit[i] += profile.ids[i].weight;
+        if (credit[i] > credit[best]) best = i;
+    }
+    credit[best] -= total_weight;
+    return &profile.ids[best];
+}
+
+// The send time goes in first, the rest stays zero: the most stuff bits,
+// so the wire is busier than the nominal load says
+static esp_err_t send_frame(const can_stress_id_t *e)
+{
+    twai_message_t msg = {
+        .identifier = e->id,
+        .data_length_code = e->dlc,
+        .extd = e->id > 0x7FF ? 1 : 0,
+        .self = 1,
+    };
+    uint32_t now_us = (uint32_t)sys_clock_us();
+    memcpy(msg.data, &now_us, sizeof(now_us));
+    return twai_transmit(&msg, pdMS_TO_TICKS(CAN_STRESS_TX_TIMEOUT_MS));
+}
+
+static void run_step(can_stress_step_t *step, int *credit, int total_weight, double mean_bits)
+{
+    double rate = step->load_pct / 100.0 * CAN_STRESS_BITRATE / mean_bits;     // Frames/s
+    step->frames_offered = (uint32_t)(rate * profile.step_ms / 1000.0);
+
+    twai_status_info_t before, status;
+    twai_get_status_info(&before);
+    uint32_t decoded_at_start = can_frames_received();
+    portENTER_CRITICAL(&lock);
+    memset(&probe, 0, sizeof(probe));
+    probe.start_us = (uint32_t)sys_clock_us();
+    probe.active = true;
+    portEXIT_CRITICAL(&lock);
+
+    // Whole bursts on a schedule, the first one right away. Behind
+    // schedule (TX queue full) it sends back to back until caught up
+    uint64_t bits = 0;
+    uint32_t n = 0;
+    int64_t start_us = sys_clock_us();
+    while (n < step->frames_offered) {
+        uint32_t due = ((uint32_t)((sys_clock_us() - start_us) * rate / 1e6) / profile.burst + 1) * profile.burst;
+        if (due > step->frames_offered) due = step->frames_offered;
+        if (n >= due) {
+            sys_clock_delay_ms(portTICK_PERIOD_MS);
+            continue;
+        }
+        for (; n < due; n++) {
+            const can_stress_id_t *e = next_id(credit, total_weight);
+            if (send_frame(e) == ESP_OK) {
+                step->frames_sent++;
+                bits += frame_bits(e);
+            } else {
+                step->tx_errors++;
+            }
+            if (twai_get_status_info(&status) == ESP_OK && status.msgs_to_rx > step->rx_high_water) {
+                step->rx_high_water = status.msgs_to_rx;
+            }
+        }
+    }
+    int64_t send_us = sys_clock_us() - start_us;
+
+    for (int waited = 0; waited < CAN_STRESS_DRAIN_MS; waited += portTICK_PERIOD_MS) {
+        if (probe_received() >= step->frames_sent) break;
+        sys_clock_delay_ms(portTICK_PERIOD_MS);
+    }
+    portENTER_CRITICAL(&lock);
+    probe.active = false;
+    uint32_t received = probe.received;
+    step->latency_avg_us = received ? (uint32_t)(probe.latency_sum_us / received) : 0;
+    step->latency_max_us = probe.latency_max_us;
+    portEXIT_CRITICAL(&lock);
+
+    // Only the test's own frames tell loss, other traffic is kept apart
+    step->frames_decoded = received;
+    step->frames_other = can_frames_received() - decoded_at_start - received;
+    if (twai_get_status_info(&status) == ESP_OK) {
+        step->rx_overruns = (status.rx_missed_count - before.rx_missed_count) +
+                            (status.rx_overrun_count - before.rx_overrun_count);
+    }
+    uint64_t load = send_us > 0 ? bits * 1000000ULL * 100 / CAN_STRESS_BITRATE / send_us : 0;
+    step->bus_load_pct = load > 100 ? 100 : (uint8_t)load;
+}
+
+static bool lossy(const can_stress_step_t *s)
+{
+    return s->frames_decoded < s->frames_sent || s->rx_overruns || s->tx_errors;
+}
+
+static void log_step(const can_stress_step_t *s)
+{
+    ESP_LOGI(TAG, "%3u%% offered, %3u%% on the bus: %lu/%lu sent, %lu decoded (+%lu other), %lu overruns, "
+             "RX queue %lu/%d, latency %lu us avg, %lu us max",
+             s->load_pct, s->bus_load_pct, s->frames_sent, s->frames_offered, s->frames_decoded,
+             s->frames_other, s->rx_overruns, s->rx_high_water, CAN_RX_QUEUE_LEN, s->latency_avg_us, s->latency_max_us);
+}
+
+static void write_results(void)
+{
+    FILE *f = fopen(MOUNT_POINT "/" CAN_STRESS_RESULTS, "w");
+    if (!f) return;     // No card, the console has it all
+    fprintf(f, "load_pct,bus_load_pct,offered,sent,tx_errors,decoded,other,rx_overruns,rx_high_water,"
+               "rx_queue_len,latency_avg_us,latency_max_us\n");
+    for (int i = 0; i < steps_done; i++) {
+        const can_stress_step_t *s = &results[i];
+        fprintf(f, "%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%d,%lu,%lu\n", s->load_pct, s->bus_load_pct,
+                s->frames_offered, s->frames_sent, s->tx_errors, s->frames_decoded, s->frames_other, s->rx_overruns,
+                s->rx_high_water, CAN_RX_QUEUE_LEN, s->latency_avg_us, s->latency_max_us);
+    }
+    fclose(f);
+}
+
+static void can_stress_task(void *arg)
+{
+    int credit[CAN_STRESS_MAX_IDS] = {0};
+    int total_weight = 0;
+    double bits = 0;
+    for (int i = 0; i < profile.id_count; i++) {
+        total_weight += profile.ids[i].weight;
+        bits += (double)profile.ids[i].weight * frame_bits(&profile.ids[i]);
+    }
+
+    int first_loss = -1;
+    for (int i = 0; i < profile.step_count; i++) {
+        can_stress_step_t step = { .load_pct = profile.loads_pct[i] };
+        run_step(&step, credit, total_weight, bits / total_weight);
+        log_step(&step);
+        if (first_loss < 0 && lossy(&step)) first_loss = i;
+
+        portENTER_CRITICAL(&lock);
+        results[i] = step;
+        steps_done = i + 1;
+        portEXIT_CRITICAL(&lock);
+    }
+    can_remove_frame_hook(probe_hook);
+    write_results();
+
+    if (first_loss < 0) {
+        ESP_LOGI(TAG, "No frames lost up to %u%% offered", profile.loads_pct[profile.step_count - 1]);
+    } else {
+        ESP_LOGW(TAG, "Frames lost from %u%% offered (%u%% on the bus)",
+                 results[first_loss].load_pct, results[first_loss].bus_load_pct);
+    }
+    running = false;
+    vTaskDelete(NULL);
+}
+
+void can_stress_default_profile(can_stress_profile_t *p)
+{
+    static const can_stress_id_t ids[] = CAN_STRESS_DEFAULT_IDS;
+    static const uint8_t loads[] = CAN_STRESS_LOADS;
+    memset(p, 0, sizeof(*p));
+    memcpy(p->ids, ids, sizeof(ids));
+    p->id_count = sizeof(ids) / sizeof(ids[0]);
+    memcpy(p->loads_pct, loads, sizeof(loads));
+    p->step_count = sizeof(loads) / sizeof(loads[0]);
+    p->burst = 1;
+    p->step_ms = CAN_STRESS_STEP_MS;
+}
+
+static bool parse_number(const char *s, int base, long min, long max, long *out)
+{
+    char *end;
+    if (!s) return false;
+    *out = strtol(s, &end, base);
+    return end != s && *end == '\0' && *out >= min && *out <= max;
+}
+
+// id_lines: the first "id" line replaces the mix instead of adding to it
+static bool parse_line(can_stress_profile_t *p, char *line, bool *id_lines)
+{
+    const char *sep = " \t\r";
+    char *save;
+    char *key = strtok_r(line, sep, &save);
+    if (!key || key[0] == '#') return true;
+    long v;
+
+    if (strcmp(key, "loads") == 0) {
+        uint8_t n = 0;
+        char *arg;
+        while ((arg = strtok_r(NULL, sep, &save)) != NULL) {
+            if (n == CAN_STRESS_MAX_STEPS || !parse_number(arg, 10, 1, 100, &v)) return false;
+            p->loads_pct[n++] = (uint8_t)v;
+        }
+        if (n == 0) return false;
+        p->step_count = n;
+    } else if (strcmp(key, "step_ms") == 0) {
+        if (!parse_number(strtok_r(NULL, sep, &save), 10, 100, 600000, &v)) return false;
+        p->step_ms = (uint32_t)v;
+    } else if (strcmp(key, "burst") == 0) {
+        if (!parse_number(strtok_r(NULL, sep, &save), 10, 1, 1000, &v)) return false;
+        p->burst = (uint16_t)v;
+    } else if (strcmp(key, "id") == 0) {
+        long id, dlc, weight;
+        if (!parse_number(strtok_r(NULL, sep, &save), 16, 0, 0x1FFFFFFF, &id) ||
+            !parse_number(strtok_r(NULL, sep, &save), 10, 4, 8, &dlc) ||
+            !parse_number(strtok_r(NULL, sep, &save), 10, 1, 100, &weight)) {
+            return false;
+        }
+        if (!*id_lines) p->id_count = 0;
+        *id_lines = true;
+        if (p->id_count == CAN_STRESS_MAX_IDS) return false;
+        p->ids[p->id_count++] = (can_stress_id_t){ (uint32_t)id, (uint8_t)dlc, (uint8_t)weight };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool can_stress_parse(can_stress_profile_t *p, const char *text)
+{
+    bool ok = true;
+    bool id_lines = false;
+    while (*text) {
+        size_t n = strcspn(text, ";\n");
+        char line[LINE_LEN];
+        if (n < sizeof(line)) {
+            memcpy(line, text, n);
+            line[n] = '\0';
+            if (!parse_line(p, line, &id_lines)) ok = false;
+        } else {
+            ok = false;
+        }
+        text += n;
+        if (*text) text++;
+    }
+    return ok;
+}
+
+esp_err_t can_stress_start(const can_stress_profile_t *p)
+{
+    if (!CAN_SELF_TEST) {
+        ESP_LOGE(TAG, "Stress test needs CAN_SELF_TEST, frames would not come back");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (running) return ESP_ERR_INVALID_STATE;
+    if (p->id_count == 0 || p->step_count == 0 || p->burst == 0) return ESP_ERR_INVALID_ARG;
+
+    profile = *p;
+    steps_done = 0;
+    if (!can_add_frame_hook(probe_hook)) {
+        ESP_LOGE(TAG, "No free CAN hook");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "%u steps of %lu ms, %u IDs, bursts of %u, RX queue %d", profile.step_count,
+             profile.step_ms, profile.id_count, profile.burst, CAN_RX_QUEUE_LEN);
+    running = true;
+    if (xTaskCreatePinnedToCore(can_stress_task, "can_stress", CAN_STRESS_TASK_STACK, NULL,
+                                CAN_STRESS_TASK_PRIORITY, NULL, CAN_STRESS_TASK_CORE) != pdPASS) {
+        can_remove_frame_hook(probe_hook);
+        running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_stress_from_card(void)
+{
+    if (!CAN_SELF_TEST) return ESP_ERR_NOT_SUPPORTED;
+    FILE *f = fopen(MOUNT_POINT "/" CAN_STRESS_CONFIG, "r");
+    if (!f) return ESP_ERR_NOT_FOUND;
+    char text[TEXT_LEN];
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[n] = '\0';
+
+    can_stress_profile_t p;
+    can_stress_default_profile(&p);
+    if (!can_stress_parse(&p, text)) ESP_LOGW(TAG, "Ignored what it did not understand in " CAN_STRESS_CONFIG);
+    return can_stress_start(&p);
+}
+
+bool can_stress_running(void)
+{
+    return running;
+}
+
+int can_stress_get_results(can_stress_step_t *steps, int max)
+{
+    portENTER_CRITICAL(&lock);
+    int n = steps_done < max ? steps_done : max;
+    memcpy(steps, results, n * sizeof(steps[0]));
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
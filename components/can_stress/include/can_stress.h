@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "can_management.h"
+
+// --- CAN STRESS ---
+// Finds the bus load where the steering wheel starts losing frames. Steps
+// through offered loads, sending a synthetic ID mix with self reception
+// like can_replay does, and measures per step what came back through the
+// RX task: decoded vs sent, driver overruns, RX queue high water and
+// latency. The table it ends with is the saturation curve, also written to
+// the card as CSV to compare releases. Needs CAN_SELF_TEST (can_management.h).
+//
+// stress.cfg at the card root starts it at boot, one setting per line or
+// separated by ';', anything left out keeps its default:
+//   loads 10 25 50 75 90 100     offered load per step, % of the bitrate
+//   step_ms 2000                 how long each step sends
+//   burst 4                      frames sent back to back, the average holds
+//   id 304 4 2                   hex ID (above 7FF: extended), DLC, weight
+#define CAN_STRESS_CONFIG       "stress.cfg"
+#define CAN_STRESS_RESULTS      "stress.csv"
+#define CAN_STRESS_BITRATE      500000
+#define CAN_STRESS_LOADS        { 10, 25, 50, 75, 90, 100 }
+#define CAN_STRESS_STEP_MS      2000
+#define CAN_STRESS_MAX_IDS      16
+#define CAN_STRESS_MAX_STEPS    16
+#define CAN_STRESS_TASK_CORE    (1 - CAN_TASK_CORE)
+#define CAN_STRESS_TASK_PRIORITY 5
+#define CAN_STRESS_TASK_STACK   4096
+#define CAN_STRESS_TX_TIMEOUT_MS 100            // A full TX queue for this long counts as an error
+#define CAN_STRESS_DRAIN_MS     200             // Between steps, for the last frames to come back
+
+// Default mix: the dashboard's own IDs at their usual proportions, plus
+// full frames at the bottom of the priority range standing in for the
+// other ECUs. The BOX alert ID is left out, it would raise alerts
+#define CAN_STRESS_DEFAULT_IDS  {                                               \
+        { ID_SPEED, 4, 4 }, { ID_RPM, 4, 4 }, { ID_ENG_TEMP, 4, 1 },            \
+        { ID_CVT_TEMP, 4, 1 }, { ID_FUEL, 4, 1 }, { ID_VOLTAGE, 4, 1 },         \
+        { 0x6F0, 8, 4 }, { 0x7F0, 8, 4 },                                       \
+    }
+
+// Stress frames carry their send time in the first four bytes, so the
+// DLC is at least 4; the decoded dashboard values are garbage meanwhile
+typedef struct {
+    uint32_t id;
+    uint8_t dlc;
+    uint8_t weight;             // Share of the frames, relative to the others
+} can_stress_id_t;
+
+typedef struct {
+    can_stress_id_t ids[CAN_STRESS_MAX_IDS];
+    uint8_t id_count;
+    uint8_t loads_pct[CAN_STRESS_MAX_STEPS];
+    uint8_t step_count;
+    uint16_t burst;
+    uint32_t step_ms;
+} can_stress_profile_t;
+
+// One point of the curve
+typedef struct {
+    uint8_t load_pct;           // Offered
+    uint8_t bus_load_pct;       // Achieved, from the frames that went out
+    uint32_t frames_offered;
+    uint32_t frames_sent;
+    uint32_t tx_errors;
+    uint32_t frames_decoded;    // Stress frames the CAN task got back
+    uint32_t frames_other;      // Anything else received during the step
+    uint32_t rx_overruns;       // Driver rx_missed + rx_overrun
+    uint32_t rx_high_water;     // Deepest RX queue seen, sampled after each send
+    uint32_t latency_avg_us;    // Before twai_transmit() to the CAN task
+    uint32_t latency_max_us;
+} can_stress_step_t;
+
+void can_stress_default_profile(can_stress_profile_t *profile);
+// Applies the settings in text (stress.cfg syntax) over profile. false on
+// a line it does not understand, the rest is still applied
+bool can_stress_parse(can_stress_profile_t *profile, const char *text);
+// Runs the steps in their own task, logging each one as it completes
+esp_err_t can_stress_start(const can_stress_profile_t *profile);
+// Starts with CAN_STRESS_CONFIG if it is on the card. ESP_ERR_NOT_FOUND
+// without one, ESP_ERR_NOT_SUPPORTED without CAN_SELF_TEST
+esp_err_t can_stress_from_card(void);
+bool can_stress_running(void);
+// Completed steps copied to steps, up to max. Returns how many
+int can_stress_get_results(can_stress_step_t *steps, int max);
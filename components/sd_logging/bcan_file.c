@@ -0,0 +1,134 @@
+#include "bcan_file.h"
+#include "sd_logging.h"
+#include <string.h>
+#include <stddef.h>
+#include "sys_clock.h"
+
+static void seal_block(bcan_file_t *bf)
+{
+    if (bf->count == 0) return;
+
+    blog_block_header_t hdr = {
+        .sync = BLOG_SYNC,
+        .record_count = bf->count,
+        .session = (uint16_t)bf->session,
+        .seq = bf->seq++,
+    };
+    memcpy(bf->block, &hdr, sizeof(hdr));
+    size_t used = sizeof(hdr) + bf->count * sizeof(bcan_record_t);
+    memset(&bf->block[used], 0, BLOG_BLOCK_SIZE - used);
+    blog_block_seal(bf->block);
+
+    log_writer_write(&bf->writer, bf->block, BLOG_BLOCK_SIZE);
+    bf->count = 0;
+}
+
+static void add_record(bcan_file_t *bf, const bcan_record_t *rec)
+{
+    if (bf->count == 0) bf->opened_us = sys_clock_us();
+    memcpy(&bf->block[sizeof(blog_block_header_t) + bf->count * sizeof(*rec)], rec, sizeof(*rec));
+    if (++bf->count == BCAN_RECORDS_PER_BLOCK) seal_block(bf);
+}
+
+static uint16_t clamp16(uint32_t v)
+{
+    return v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+static void health_snapshot(bcan_health_t *out)
+{
+    _Static_assert(sizeof(blog_file_header_t) <= BCAN_HEALTH_OPEN_OFFSET &&
+                   BCAN_HEALTH_OPEN_OFFSET + sizeof(bcan_health_t) <= BCAN_HEALTH_CLOSE_OFFSET &&
+                   BCAN_HEALTH_CLOSE_OFFSET + sizeof(bcan_health_t) <= BLOG_BLOCK_SIZE,
+                   "Health snapshots must fit the header block");
+    can_health_t h;
+    can_get_health(&h);
+    *out = (bcan_health_t){
+        .timestamp_us = sys_clock_us(),
+        .rx_missed = h.rx_missed,
+        .rx_overrun = h.rx_overrun,
+        .arb_lost = h.arb_lost,
+        .bus_error = h.bus_error,
+        .tx_failed = h.tx_failed,
+        .bus_off = h.bus_off,
+        .rx_queue_len = CAN_RX_QUEUE_LEN,
+        .rx_queued_max = clamp16(h.rx_queued_max),
+        .tx_err_max = clamp16(h.tx_err_max),
+        .rx_err_max = clamp16(h.rx_err_max),
+        .tx_err = clamp16(h.tx_err),
+        .rx_err = clamp16(h.rx_err),
+        .state = h.state,
+    };
+}
+
+esp_err_t bcan_file_open(bcan_file_t *bf, const char *path, uint32_t session, uint64_t prealloc_bytes)
+{
+    bf->count = 0;
+    bf->seq = 0;
+    bf->session = session;
+
+    esp_err_t ret = log_writer_open(&bf->writer, path, prealloc_bytes);
+    if (ret != ESP_OK) return ret;
+
+    blog_file_header_t hdr = {
+        .magic = BCAN_MAGIC,
+        .version = BCAN_VERSION,
+        .block_size = BLOG_BLOCK_SIZE,
+        .header_size = sizeof(blog_file_header_t),
+        .record_size = sizeof(bcan_record_t),
+        .session = session,
+    };
+    memset(bf->block, 0, sizeof(bf->block));
+    memcpy(bf->block, &hdr, sizeof(hdr));
+    bcan_health_t health;
+    health_snapshot(&health);
+    memcpy(&bf->block[BCAN_HEALTH_OPEN_OFFSET], &health, sizeof(health));
+    log_writer_write(&bf->writer, bf->block, BLOG_BLOCK_SIZE);
+    log_writer_flush(&bf->writer, true);
+    return ESP_OK;
+}
+
+void bcan_file_add_frame(bcan_file_t *bf, const can_frame_t *frame)
+{
+    bcan_record_t rec = {
+        .timestamp_us = frame->timestamp_us,
+        .can_id = frame->id,
+        .len = frame->dlc > 8 ? 8 : frame->dlc,
+    };
+    if (frame->flags & CAN_FRAME_EXTD) rec.can_id |= BCAN_EFF_FLAG;
+    if (frame->flags & CAN_FRAME_RTR) rec.can_id |= BCAN_RTR_FLAG;
+    memcpy(rec.data, frame->data, sizeof(rec.data));
+    add_record(bf, &rec);
+}
+
+void bcan_file_add_marker(bcan_file_t *bf, uint32_t can_id, int64_t timestamp_us, uint32_t value)
+{
+    bcan_record_t rec = {
+        .timestamp_us = timestamp_us,
+        .can_id = can_id,
+        .len = 4,
+    };
+    memcpy(rec.data, &value, sizeof(value));
+    add_record(bf, &rec);
+}
+
+void bcan_file_poll(bcan_file_t *bf)
+{
+    // Same power-loss bound as the sample log
+    int64_t max_age_ms = SD_LOG_FSYNC_MS ? SD_LOG_FSYNC_MS : SD_LOG_FLUSH_MS;
+    if (bf->count > 0 && sys_clock_us() - bf->opened_us >= max_age_ms * 1000LL) {
+        seal_block(bf);
+    }
+    log_writer_poll(&bf->writer);
+}
+
+void bcan_file_close(bcan_file_t *bf)
+{
+    seal_block(bf);
+    bcan_health_t health;
+    health_snapshot(&health);
+    log_writer_patch(&bf->writer, BCAN_HEALTH_CLOSE_OFFSET, &health, sizeof(health));
+    uint32_t flags = BLOG_FLAG_CLOSED;
+    log_writer_patch(&bf->writer, offsetof(blog_file_header_t, flags), &flags, sizeof(flags));
+    log_writer_close(&bf->writer);
+}
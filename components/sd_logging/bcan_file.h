@@ -0,0 +1,26 @@
+#pragma once
+#include "log_format.h"
+#include "log_writer.h"
+#include "can_management.h"
+
+// One raw CAN file (BCAN_MAGIC, format in log_format.h): packs records into
+// numbered, CRC-sealed blocks and hands them to its writer. Used by the
+// continuous capture and by event files. Logger task only.
+typedef struct {
+    log_writer_t writer;
+    uint8_t block[BLOG_BLOCK_SIZE];
+    uint16_t count;         // Records in the open block
+    uint32_t seq;           // Number of the next sealed block
+    uint32_t session;
+    int64_t opened_us;      // When the open block got its first record
+} bcan_file_t;
+
+// Writes the header block, prealloc_bytes as in log_writer_open()
+esp_err_t bcan_file_open(bcan_file_t *bf, const char *path, uint32_t session, uint64_t prealloc_bytes);
+void bcan_file_add_frame(bcan_file_t *bf, const can_frame_t *frame);
+// Non-bus record (BCAN_DROP_MARK, BCAN_EVENT_MARK) with a 32 bit argument
+void bcan_file_add_marker(bcan_file_t *bf, uint32_t can_id, int64_t timestamp_us, uint32_t value);
+// Seals a block older than the fsync period and lets the writer flush
+void bcan_file_poll(bcan_file_t *bf);
+// Seals the open block, marks the file closed and closes it
+void bcan_file_close(bcan_file_t *bf);
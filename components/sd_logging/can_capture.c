@@ -0,0 +1,94 @@
+#include "can_capture.h"
+#include "sd_logging.h"
+#include "bcan_file.h"
+#include "log_ring.h"
+#include "log_stats.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "sys_clock.h"
+
+static const char *TAG = "CAN_CAPTURE";
+
+static log_ring_t frame_ring;
+static bcan_file_t file;
+static volatile bool running = false;
+static uint32_t dropped_reported = 0;
+
+void can_capture_push(const can_frame_t *frame)
+{
+    if (running) log_ring_push(&frame_ring, frame);
+}
+
+esp_err_t can_capture_start(uint32_t session)
+{
+    char filename[32];
+    sprintf(filename, "%s/can_%lu.bin", MOUNT_POINT, session);
+
+    if (frame_ring.buf) log_ring_free(&frame_ring);
+    esp_err_t ret = log_ring_init(&frame_ring, sizeof(can_frame_t), SD_CAN_RING_LEN, LOG_RING_DROP_NEWEST);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate frame ring");
+        return ret;
+    }
+
+    ret = bcan_file_open(&file, filename, session, SD_CAN_PREALLOC_MB * 1024ULL * 1024ULL);
+    if (ret != ESP_OK) {
+        log_ring_free(&frame_ring);
+        return ret;
+    }
+
+    dropped_reported = 0;
+    running = true;
+
+    ESP_LOGI(TAG, "Capturing raw CAN to: %s", filename);
+    return ESP_OK;
+}
+
+void can_capture_service(void)
+{
+    if (!running) return;
+
+    // DROP_NEWEST: whatever is queued came before any frame lost so far.
+    // Count first, then read the drops, so the marker goes after exactly
+    // those frames and before anything pushed since
+    uint32_t queued = log_ring_count(&frame_ring);
+    uint32_t dropped = log_ring_dropped(&frame_ring);
+    log_stats_high_water(&log_stats.can_ring_high_water, queued);
+
+    can_frame_t frame;
+    int64_t last_us = sys_clock_us();
+    for (uint32_t i = 0; i < queued && log_ring_pop(&frame_ring, &frame); i++) {
+        bcan_file_add_frame(&file, &frame);
+        last_us = frame.timestamp_us;
+    }
+
+    // Leaves a marker in the stream where frames went missing, stamped
+    // with the last frame before the gap
+    if (dropped != dropped_reported) {
+        bcan_file_add_marker(&file, BCAN_DROP_MARK, last_us, dropped - dropped_reported);
+        ESP_LOGW(TAG, "%lu frames dropped", dropped - dropped_reported);
+        dropped_reported = dropped;
+    }
+
+    while (log_ring_pop(&frame_ring, &frame)) {
+        bcan_file_add_frame(&file, &frame);
+    }
+    bcan_file_poll(&file);
+}
+
+void can_capture_stop(void)
+{
+    if (!running) return;
+
+    can_capture_service();
+    running = false;
+    bcan_file_close(&file);
+
+    // The ring stays allocated: the CAN task may still be inside the hook
+    ESP_LOGI(TAG, "Capture closed, %lu frames dropped", log_ring_dropped(&frame_ring));
+}
+
+uint32_t can_capture_dropped(void)
+{
+    return running ? log_ring_dropped(&frame_ring) : 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "can_management.h"
+
+// Raw CAN capture to can_N.bin (format in log_format.h)
+// The CAN task pushes frames into a ring through can_capture_push(),
+// the logger task drains it with can_capture_service().
+
+esp_err_t can_capture_start(uint32_t session);
+// CAN task, from the frame hook. Wait-free, no-op when not capturing
+void can_capture_push(const can_frame_t *frame);
+// Logger task: drains the ring into blocks and lets the writer flush
+void can_capture_service(void);
+// Logger task: drains, seals and closes the file
+void can_capture_stop(void);
+uint32_t can_capture_dropped(void);
@@ -0,0 +1,125 @@
+#include "csv_format.h"
+#include "log_format.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static int digit_count(uint32_t v)
+{
+    int n = 1;
+    while (v >= 10000) { v /= 10000; n += 4; }
+    if (v >= 1000) return n + 3;
+    if (v >= 100) return n + 2;
+    if (v >= 10) return n + 1;
+    return n;
+}
+
+// Two digits per division, written in place from the end
+static char *put_u32(char *p, uint32_t v)
+{
+    char *end = p + digit_count(v);
+    char *t = end;
+    while (v >= 100) {
+        const char *d = &digit_pairs[(v % 100) * 2];
+        v /= 100;
+        *--t = d[1];
+        *--t = d[0];
+    }
+    if (v >= 10) {
+        *--t = digit_pairs[v * 2 + 1];
+        *--t = digit_pairs[v * 2];
+    } else {
+        *--t = (char)('0' + v);
+    }
+    return end;
+}
+
+static char *put_i32(char *p, int32_t v)
+{
+    if (v < 0) {
+        *p++ = '-';
+        return put_u32(p, 0u - (uint32_t)v);
+    }
+    return put_u32(p, (uint32_t)v);
+}
+
+// %.Nf of a float, N <= 4. The float is m * 2^e exactly, so v * 10^N is
+// rounded from its exact binary value, ties to even, the way printf does
+static char *put_fixed(char *p, float v, int decimals)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint32_t exp = (bits >> 23) & 0xFF;
+    uint32_t frac = bits & 0x7FFFFF;
+
+    // Inf/NaN or >= 2^23, never a logged value, let printf handle it
+    if (exp == 0xFF || exp >= 150) {
+        return p + sprintf(p, "%.*f", decimals, (double)v);
+    }
+
+    uint64_t m = (exp == 0) ? frac : (frac | 0x800000);
+    int shift = (exp == 0) ? 149 : 150 - (int)exp;   // v = m / 2^shift
+
+    uint32_t pow10 = 1;
+    for (int i = 0; i < decimals; i++) pow10 *= 10;
+    uint64_t scaled = m * pow10;                    // < 2^38
+
+    uint64_t q;
+    if (shift >= 64) {
+        q = 0;                                      // Far below half a unit
+    } else {
+        q = scaled >> shift;
+        uint64_t rem = scaled & ((1ULL << shift) - 1);
+        uint64_t half = 1ULL << (shift - 1);
+        if (rem > half || (rem == half && (q & 1))) q++;
+    }
+
+    // printf keeps the sign of negative values rounding to zero ("-0.00")
+    if (bits >> 31) *p++ = '-';
+    p = put_u32(p, (uint32_t)(q / pow10));
+    if (decimals > 0) {
+        *p++ = '.';
+        uint32_t f = (uint32_t)(q % pow10);
+        for (uint32_t d = pow10 / 10; d > 0; d /= 10) {
+            *p++ = (char)('0' + f / d % 10);
+        }
+    }
+    return p;
+}
+
+size_t csv_format_header(char *dst, size_t size)
+{
+    size_t len = strlen("Time_ms");
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) len += 1 + strlen(log_fields[i].name);
+    if (len + 2 > size) return 0;
+
+    char *p = dst;
+    p += sprintf(p, "Time_ms");
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) p += sprintf(p, ",%s", log_fields[i].name);
+    *p++ = '\n';
+    *p = '\0';
+    return p - dst;
+}
+
+size_t csv_format_row(char *dst, const sd_log_record_t *rec)
+{
+    char *p = put_u32(dst, rec->timestamp_ms);
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) {
+        const log_field_t *f = &log_fields[i];
+        *p++ = ',';
+        const uint8_t *src = (const uint8_t *)rec + f->offset;
+        switch (f->src_type) {
+            case BLOG_U8:  p = put_u32(p, *src); break;
+            case BLOG_U16: p = put_u32(p, *(const uint16_t *)src); break;
+            case BLOG_I16: p = put_i32(p, *(const int16_t *)src); break;
+            case BLOG_F32: p = put_fixed(p, *(const float *)src, -f->exp10); break;
+            default:       p = put_i32(p, log_field_read(rec, f)); break;
+        }
+    }
+    *p++ = '\n';
+    return p - dst;
+}
@@ -0,0 +1,128 @@
+#include "event_capture.h"
+#include "sd_logging.h"
+#include "bcan_file.h"
+#include "log_ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "sys_clock.h"
+
+static const char *TAG = "EVENT_CAPTURE";
+
+// Sliding pre-trigger window: drop-oldest, only drained while capturing
+static log_ring_t pre_ring;
+static bcan_file_t file;
+static volatile bool started = false;
+static bool capturing = false;
+static uint32_t capture_session = 0;
+static uint32_t event_count = 0;
+static bool cap_logged = false;
+static int64_t capture_end_us = 0;
+static uint32_t dropped_reported = 0;
+static _Atomic uint32_t pending_reasons = 0;
+
+esp_err_t event_capture_start(uint32_t session)
+{
+    if (pre_ring.buf) log_ring_free(&pre_ring);
+    esp_err_t ret = log_ring_init(&pre_ring, sizeof(can_frame_t), SD_EVENT_RING_LEN, LOG_RING_DROP_OLDEST);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate pre-trigger ring");
+        return ret;
+    }
+    capture_session = session;
+    event_count = 0;
+    cap_logged = false;
+    capturing = false;
+    atomic_store(&pending_reasons, 0);
+    started = true;
+    ESP_LOGI(TAG, "Pre-trigger ring: %d frames, %u KB", SD_EVENT_RING_LEN,
+             (unsigned)(SD_EVENT_RING_LEN * sizeof(can_frame_t) / 1024));
+    return ESP_OK;
+}
+
+void event_capture_push(const can_frame_t *frame)
+{
+    if (started) log_ring_push(&pre_ring, frame);
+}
+
+void event_capture_trigger(uint32_t reasons)
+{
+    atomic_fetch_or(&pending_reasons, reasons);
+}
+
+static bool open_event_file(int64_t now)
+{
+    char filename[40];
+    if (event_count >= SD_EVENT_MAX_FILES) {
+        if (!cap_logged) {
+            cap_logged = true;
+            ESP_LOGW(TAG, "%d event files this session, no more are saved", SD_EVENT_MAX_FILES);
+        }
+        return false;
+    }
+
+    // 8.3 names only: E<session>/EV<n>.BIN, numbers never reused
+    sprintf(filename, "%s/E%lu", MOUNT_POINT, capture_session);
+    if (event_count == 0 && mkdir(filename, 0777) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "Failed to create %s", filename);
+        return false;
+    }
+    sprintf(filename + strlen(filename), "/EV%lu.BIN", event_count + 1);
+    if (bcan_file_open(&file, filename, capture_session, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open %s", filename);
+        return false;
+    }
+    event_count++;
+
+    // Pre-trigger part: skip what is older than the window
+    can_frame_t frame;
+    int64_t window_start = now - SD_EVENT_PRE_MS * 1000LL;
+    while (log_ring_pop(&pre_ring, &frame)) {
+        if (frame.timestamp_us >= window_start) bcan_file_add_frame(&file, &frame);
+    }
+    // Whatever the ring lost before the trigger is the window sliding
+    dropped_reported = log_ring_dropped(&pre_ring);
+    ESP_LOGI(TAG, "Event capture to: %s", filename);
+    return true;
+}
+
+void event_capture_service(void)
+{
+    if (!started) return;
+
+    int64_t now = sys_clock_us();
+    uint32_t reasons = atomic_exchange(&pending_reasons, 0);
+    if (reasons) {
+        if (!capturing) capturing = open_event_file(now);
+        if (capturing) {
+            bcan_file_add_marker(&file, BCAN_EVENT_MARK, now, reasons);
+            capture_end_us = now + SD_EVENT_POST_MS * 1000LL;
+        }
+    }
+    if (!capturing) return;
+
+    // Post-trigger part, every frame counts now
+    uint32_t dropped = log_ring_dropped(&pre_ring);
+    if (dropped != dropped_reported) {
+        bcan_file_add_marker(&file, BCAN_DROP_MARK, now, dropped - dropped_reported);
+        dropped_reported = dropped;
+    }
+    can_frame_t frame;
+    while (log_ring_pop(&pre_ring, &frame)) {
+        bcan_file_add_frame(&file, &frame);
+    }
+    bcan_file_poll(&file);
+
+    if (now >= capture_end_us) event_capture_stop();
+}
+
+void event_capture_stop(void)
+{
+    if (!capturing) return;
+    capturing = false;
+    bcan_file_close(&file);
+    ESP_LOGI(TAG, "Event capture closed");
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "can_management.h"
+
+// Event capture: the last SD_EVENT_RING_LEN raw frames are always kept in
+// RAM. When an event fires, the ones from the last SD_EVENT_PRE_MS go to a
+// new E<session>/EV<n>.BIN file (raw CAN format, see log_format.h), followed
+// by every frame of the next SD_EVENT_POST_MS. Events during a capture
+// extend it. The logger task does all the file work.
+
+esp_err_t event_capture_start(uint32_t session);
+// CAN task, from the frame hook. Wait-free, no-op when not started
+void event_capture_push(const can_frame_t *frame);
+// Any task: flags an event, reasons is a mask of 1 << sd_event_t
+void event_capture_trigger(uint32_t reasons);
+// Logger task: opens, fills and closes event files
+void event_capture_service(void);
+// Logger task: closes an event file in progress
+void event_capture_stop(void);
@@ -0,0 +1,29 @@
+#pragma once
+// CSV rows without printf: integers and fixed-point decimals written
+// straight into the caller's buffer, no allocation, no float formatting.
+// Output is byte-identical to the old
+//   "%lu,%d,%d,%d,%.2f,%d,%d,%d,%d\n"
+// row: integer fields print their raw value, float fields -exp10 decimals
+// rounded exactly like printf. Plain C, the host benchmark builds it too.
+#include <stddef.h>
+#include "log_record.h"
+
+// Longest field ("-2147483648", or a float up to FLT_MAX with 4 decimals)
+// and row csv_format_row() can produce, terminator not included
+#define CSV_FIELD_MAX   45
+#define CSV_ROW_MAX     (10 + LOG_FIELD_COUNT * (1 + CSV_FIELD_MAX) + 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Column names from log_fields[], "Time_ms,RPM,...\n". Returns the length,
+// 0 if it does not fit in size
+size_t csv_format_header(char *dst, size_t size);
+// One row into dst (at least CSV_ROW_MAX bytes), not terminated.
+// Returns the length
+size_t csv_format_row(char *dst, const sd_log_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,175 @@
+#pragma once
+// Binary log format, shared by the firmware and the host tools in tools/
+// Plain C and stdint only, keep it that way so it builds anywhere.
+//
+// File layout (all integers little endian):
+//   [file header + signal table, padded to one block]
+//   [block][block][block]...
+//
+// Every block is BLOG_BLOCK_SIZE bytes:
+//   blog_block_header_t | records... | zero padding | crc32 (last 4 bytes)
+// The CRC covers everything before it. Blocks are numbered: data block seq
+// sits at file offset (seq + 1) * BLOG_BLOCK_SIZE and carries the low bits
+// of the session, so a valid block left over from an older file on the same
+// clusters is told apart from a fresh one. That makes the valid blocks a
+// prefix of the file, which log_recover_file() finds by bisection.
+// A record is a dt_ms byte (time since
+// the previous record, or since base_ms for the first one) followed by one
+// value per signal, in signal table order, each packed as its blog_type_t.
+//
+// With BLOG_FLAG_DELTA set only the first record of a block is stored that
+// way (the keyframe, so every block decodes on its own). The others are:
+//   dt_ms | change bitmap, (signal_count + 7) / 8 bytes, bit i = signal i |
+//   one zigzag LEB128 varint per set bit: value - previous value
+// Records are then variable length and record_size is the keyframe size.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOG_MAGIC          "BAJALOG"   // 8 bytes with the terminator
+#define BLOG_VERSION        3         // 2: seq + session in block headers, 3: delta records
+#define BLOG_VERSION_MIN    2         // Oldest version the tools still read
+#define BLOG_BLOCK_SIZE     512         // One SD sector
+#define BLOG_SYNC           0x4B4C4242u // "BBLK" on disk
+#define BLOG_MAX_SIGNALS    16
+#define BLOG_NAME_LEN       16
+#define BLOG_UNIT_LEN       8
+#define BLOG_CRC_SIZE       4
+
+typedef enum {
+    BLOG_U8 = 1,
+    BLOG_I8,
+    BLOG_U16,
+    BLOG_I16,
+    BLOG_U32,
+    BLOG_I32,
+    BLOG_F32,       // Only as a source type on the device, never on disk
+} blog_type_t;
+
+typedef struct __attribute__((packed)) {
+    char magic[8];
+    uint16_t version;
+    uint16_t block_size;
+    uint16_t header_size;       // Bytes actually used in the header block
+    uint8_t signal_count;
+    uint8_t record_size;        // dt byte + packed signals
+    uint32_t session;           // log_N number
+    uint32_t flags;             // BLOG_FLAG_*
+} blog_file_header_t;
+
+// Set when the file was closed cleanly and cut to its real length.
+// Without it the file may end in preallocated junk, see log_recover_file()
+#define BLOG_FLAG_CLOSED    0x00000001u
+// Records after the first of each block are delta coded, see above
+#define BLOG_FLAG_DELTA     0x00000002u
+
+// Value on disk * 10^exp10 = value in unit
+typedef struct __attribute__((packed)) {
+    char name[BLOG_NAME_LEN];
+    char unit[BLOG_UNIT_LEN];
+    uint8_t type;               // blog_type_t
+    int8_t exp10;
+    uint8_t reserved[2];
+} blog_signal_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t sync;
+    uint16_t record_count;
+    uint16_t session;           // Low 16 bits of the file header session
+    uint32_t seq;               // Data block number, 0 right after the header block
+    uint32_t base_ms;           // Timestamp the dt of the first record is relative to
+} blog_block_header_t;
+
+#define BLOG_BLOCK_PAYLOAD  (BLOG_BLOCK_SIZE - sizeof(blog_block_header_t) - BLOG_CRC_SIZE)
+
+// --- Raw CAN capture (can_N.bin) ---
+// Same header block and block framing as the sample log, magic BCAN_MAGIC,
+// no signal table. Each record ends with a Linux SocketCAN struct can_frame
+// (can_id with the CAN_*_FLAG bits, len, 3 pad bytes, data[8]), so it can be
+// handed to socketcan tools as is. base_ms in the block header is unused.
+#define BCAN_MAGIC          "BAJACAN"
+#define BCAN_VERSION        2
+#define BCAN_EFF_FLAG       0x80000000u // Extended 29 bit ID
+#define BCAN_RTR_FLAG       0x40000000u // Remote frame
+#define BCAN_ERR_FLAG       0x20000000u // Not a bus frame, see BCAN_DROP_MARK
+#define BCAN_DROP_MARK      (BCAN_ERR_FLAG | 0x1000) // data[0..3] = frames lost here
+#define BCAN_EVENT_MARK     (BCAN_ERR_FLAG | 0x2000) // data[0..3] = trigger reasons mask
+
+typedef struct __attribute__((packed)) {
+    uint64_t timestamp_us;
+    uint32_t can_id;
+    uint8_t len;
+    uint8_t pad;
+    uint8_t res0;
+    uint8_t res1;
+    uint8_t data[8];
+} bcan_record_t;
+
+#define BCAN_RECORDS_PER_BLOCK  (BLOG_BLOCK_PAYLOAD / sizeof(bcan_record_t))
+
+// CAN controller health in the otherwise empty header block: one snapshot
+// when the file is opened, one patched in when it is closed cleanly. All
+// zero = not taken (files from before, or cut off by a power loss)
+#define BCAN_HEALTH_OPEN_OFFSET     64
+#define BCAN_HEALTH_CLOSE_OFFSET    128
+
+typedef struct __attribute__((packed)) {
+    uint64_t timestamp_us;      // Device time of the snapshot
+    uint32_t rx_missed;         // Driver counters since boot
+    uint32_t rx_overrun;
+    uint32_t arb_lost;
+    uint32_t bus_error;
+    uint32_t tx_failed;
+    uint32_t bus_off;
+    uint16_t rx_queue_len;
+    uint16_t rx_queued_max;     // High water since boot, checked on every frame
+    uint16_t tx_err_max;
+    uint16_t rx_err_max;
+    uint16_t tx_err;            // Error counters at the snapshot
+    uint16_t rx_err;
+    uint8_t state;              // twai_state_t
+    uint8_t reserved;
+} bcan_health_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Standard CRC-32 (IEEE 802.3), pass 0 to start
+uint32_t blog_crc32(uint32_t crc, const void *data, size_t len);
+
+// Bytes a value of this type takes on disk, 0 if unknown
+size_t blog_type_size(uint8_t type);
+
+// Packs / unpacks one value, clamping it to the type range when packing
+void blog_put_value(uint8_t *dst, uint8_t type, int32_t value);
+int32_t blog_get_value(const uint8_t *src, uint8_t type);
+// The value blog_put_value() would store, i.e. what a reader gets back
+int32_t blog_clamp_value(uint8_t type, int32_t value);
+
+// Zigzag varint, 1 byte for -64..63, 5 at most. get returns the bytes
+// consumed, 0 if the varint runs past end
+size_t blog_put_varint(uint8_t *dst, int32_t value);
+size_t blog_get_varint(const uint8_t *src, const uint8_t *end, int32_t *value);
+
+// The file header block has no CRC: true if every signal type is known and
+// record_size matches them, which blog_decode_block() relies on
+bool blog_signals_valid(const blog_file_header_t *hdr, const blog_signal_t *sig);
+
+// Calls fn for every record of a valid sample block, either encoding.
+// The header must have passed blog_signals_valid().
+// Returns the number of records, -1 if the block is malformed
+typedef void (*blog_record_fn)(void *ctx, uint32_t t_ms, const int32_t *vals);
+int blog_decode_block(const blog_file_header_t *hdr, const blog_signal_t *sig,
+                      const uint8_t *block, blog_record_fn fn, void *ctx);
+
+// Seals a filled block: writes the CRC into its last 4 bytes
+void blog_block_seal(uint8_t *block);
+// True if the block has the sync word and a matching CRC
+bool blog_block_valid(const uint8_t *block);
+// Valid, and written by this session as data block number seq
+bool blog_block_in_sequence(const uint8_t *block, uint32_t session, uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+// The logged sample and the table describing its fields. Plain C, shared
+// with the host tools like log_format.h.
+#include <stdint.h>
+#include <stddef.h>
+
+// One logged sample, what goes through the ring
+typedef struct {
+    uint32_t timestamp_ms;
+    uint16_t rpm;
+    uint16_t speed;
+    uint16_t fuel;
+    int16_t roll;
+    int16_t pitch;
+    uint8_t cvt_temp;
+    uint8_t eng_temp;
+    uint8_t box_call;   // 0 = none, else 1 + box_message
+    float voltage;
+} sd_log_record_t;
+
+// What gets logged, in record (and CSV column) order. Adding a signal to
+// log_fields[] is enough: the binary header describes it, the CSV header
+// is generated from it and the host tools pick it up.
+typedef struct {
+    const char *name;
+    const char *unit;
+    uint8_t type;       // blog_type_t on disk
+    int8_t exp10;       // Disk value * 10^exp10 = real value
+    uint8_t src_type;   // Field type in sd_log_record_t
+    uint8_t offset;     // Field offset in sd_log_record_t
+} log_field_t;
+
+#define LOG_FIELD_COUNT 9
+extern const log_field_t log_fields[LOG_FIELD_COUNT];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Integer source fields as they are, floats as value * 10^-exp10 rounded
+// to the nearest integer (the binary encoding of the field)
+int32_t log_field_read(const sd_log_record_t *rec, const log_field_t *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+// Single-producer / single-consumer ring of fixed-size records, no locks.
+// The producer side is wait-free: one bounded pass, never blocks or spins,
+// so it is safe to call from the CAN and render tasks.
+
+typedef enum {
+    LOG_RING_DROP_NEWEST,   // Full ring rejects the new record
+    LOG_RING_DROP_OLDEST,   // Full ring discards its oldest record
+} log_ring_overflow_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t elem_size;
+    uint32_t mask;              // Capacity - 1, capacity is a power of two
+    log_ring_overflow_t policy;
+    _Atomic uint32_t head;      // Next slot to write, producer only
+    _Atomic uint32_t tail;      // Next slot to read, producer moves it in DROP_OLDEST
+    _Atomic uint32_t dropped;   // Records lost to overflow
+} log_ring_t;
+
+esp_err_t log_ring_init(log_ring_t *r, size_t elem_size, uint32_t capacity, log_ring_overflow_t policy);
+void log_ring_free(log_ring_t *r);
+
+// Producer, returns false if the record was dropped
+bool log_ring_push(log_ring_t *r, const void *elem);
+// Consumer, returns false if the ring is empty
+bool log_ring_pop(log_ring_t *r, void *elem);
+
+static inline uint32_t log_ring_count(log_ring_t *r) {
+    return atomic_load_explicit(&r->head, memory_order_acquire) -
+           atomic_load_explicit(&r->tail, memory_order_acquire);
+}
+
+static inline uint32_t log_ring_dropped(log_ring_t *r) {
+    return atomic_load_explicit(&r->dropped, memory_order_relaxed);
+}
@@ -2,6 +2,8 @@
 
 #include "esp_err.h"
 #include "can_management.h"
+#include "log_ring.h"
+#include "log_record.h"
 
 // --- PIN CONFIGURATION (HSPI) ---
 #define SD_MISO  GPIO_NUM_19
@@ -11,8 +13,117 @@
 
 #define MOUNT_POINT "/sdcard"
 
+// --- SPI CLOCK ---
+// Mounts at identification speed, then steps up while CRC-checked reads
+// and a write/readback test pass. Card errors later step it back down.
+#define SD_SPI_STEPS_KHZ        { 400, 5000, 10000, 20000 }
+#define SD_SPI_TEST_SECTORS     8   // Read/written per test pass
+#define SD_SPI_TEST_PASSES      4
+
+// --- WRITE POLICY ---
+// The log file stays open for the whole session. Rows pile up in RAM and
+// are pushed to the card in big chunks, fsync bounds what a power cut loses.
+#define SD_ALLOC_UNIT_SIZE  (16 * 1024) // Cluster size when the card is formatted
+#define SD_LOG_BUFFER_SIZE  SD_ALLOC_UNIT_SIZE // One aligned cluster per card write
+#define SD_LOG_FLUSH_BYTES  (8 * 1024)  // Flush once this much is pending...
+#define SD_LOG_FLUSH_MS     500         // ...or when the oldest row is this old
+#define SD_LOG_FSYNC_MS     2000        // Max data lost on power cut, 0 = fsync every flush
+
+// Binary logs reserve a contiguous region at session start so no FAT
+// allocation happens while racing. Past it the file just grows normally.
+#define SD_LOG_PREALLOC_MB  16          // ~10 h of samples
+#define SD_CAN_PREALLOC_MB  64          // ~10 min of a fully loaded bus
+
+// --- FILE FORMAT ---
+// Binary is ~2.5x smaller (15 KB per 1000 samples, 35-40 KB as CSV) and
+// needs no float formatting, see log_format.h
+// and tools/blog_convert to turn it into CSV on a PC
+#define SD_LOG_FORMAT_CSV       0
+#define SD_LOG_FORMAT_BINARY    1
+#define SD_LOG_FORMAT           SD_LOG_FORMAT_BINARY
+// Binary only: store what changed since the previous sample as varints.
+// Temperatures, fuel and volts barely move, a typical record drops from
+// 13 bytes to about 5
+#define SD_LOG_DELTA            1
+
+// --- LOGGER TASK ---
+// Card writes can stall for tens of ms, so they happen in their own task
+// fed by a lock-free ring. Producers never wait on the card.
+#define SD_LOG_TASK_CORE        (1 - CAN_TASK_CORE)  // Never on the CAN core
+#define SD_LOG_TASK_PRIORITY    2
+#define SD_LOG_TASK_STACK       4096
+#define SD_LOG_TASK_PERIOD_MS   20
+#define SD_LOG_RING_LEN         256     // Records, must be a power of two
+#define SD_LOG_OVERFLOW         LOG_RING_DROP_OLDEST
+
+// --- RAW CAN CAPTURE ---
+// Every received frame goes to can_N.bin next to log_N.bin. A loaded
+// 500 kbit/s bus is ~4000 frames/s, the ring covers SD stalls of
+// SD_CAN_RING_LEN / 4000 s (256 ms). Needs a fast SPI clock to keep up.
+#define SD_CAN_CAPTURE          1
+#define SD_CAN_RING_LEN         1024    // Frames, must be a power of two
+
+// --- EVENT CAPTURE ---
+// The newest SD_EVENT_RING_LEN frames always sit in RAM (24 B each). An
+// event (alert, BOX call, bus-off, long button press) dumps the last
+// SD_EVENT_PRE_MS of them plus the next SD_EVENT_POST_MS to EN/EVM.BIN,
+// one directory per session N (long names are off, 8.3 only).
+// 2048 frames is ~0.5 s of a fully loaded bus, seconds of normal traffic.
+#define SD_EVENT_CAPTURE        1
+#define SD_EVENT_RING_LEN       2048    // Frames, must be a power of two
+#define SD_EVENT_PRE_MS         3000
+#define SD_EVENT_POST_MS        5000
+#define SD_EVENT_MAX_FILES      999     // Per session, EV1.BIN to EV999.BIN. Later events are not saved
+
+// --- HEALTH STATS ---
+// Every card write and fsync is timed into log2 histograms, see
+// sd_log_get_stats(). STN.TXT gets a dump this often and at deinit.
+#define SD_STATS_BUCKETS        20      // Bucket i: [2^i, 2^(i+1)) us, the last one open ended
+#define SD_STATS_DUMP_MS        60000
+
+typedef struct {
+    uint32_t write_hist[SD_STATS_BUCKETS];  // Card writes, one chunk each
+    uint32_t sync_hist[SD_STATS_BUCKETS];   // fsync calls
+    uint32_t write_max_us;
+    uint32_t sync_max_us;
+    uint32_t write_errors;
+    uint64_t bytes_written;                 // All files, as sent to the card
+    uint32_t log_ring_high_water;           // Records, of SD_LOG_RING_LEN
+    uint32_t can_ring_high_water;           // Frames, of SD_CAN_RING_LEN
+    uint32_t log_dropped;
+    uint32_t can_dropped;
+    uint32_t spi_khz;
+} sd_log_stats_t;
+
+// What fired an event capture, stored as a bit mask in the file
+typedef enum {
+    SD_EVENT_MANUAL = 0,    // Driver long press
+    SD_EVENT_ALERT,         // Alert engine raised a new alert
+    SD_EVENT_BOX,           // BOX alert from the pits
+    SD_EVENT_BUS_OFF,       // CAN controller went bus-off
+} sd_event_t;
+
+// Mounts the card, opens the session file and starts the logger task
 esp_err_t sd_logging_init(void);
 
+// Queues one sample, wait-free and O(1), safe from any single producer task
 void sd_log_data(car_state_t *car, uint32_t timestamp_ms);
 
+// Records lost because the ring was full
+uint32_t sd_log_dropped(void);
+// Raw CAN frames lost because the capture ring was full
+uint32_t sd_can_capture_dropped(void);
+// SPI clock the card ended up running at
+uint32_t sd_logging_spi_khz(void);
+// Snapshot of the logger health counters, safe from any task. The
+// histograms are read while the logger task may be updating them
+void sd_log_get_stats(sd_log_stats_t *stats);
+// Starts (or extends) an event capture. Wait-free, safe from any task
+// including the CAN task callbacks
+void sd_log_event(sd_event_t reason);
+
+// Asks the logger task to push buffered rows to the card and commit them
+void sd_log_flush(void);
+
+// Drains the ring, closes the file and unmounts
 void sd_logging_deinit(void);
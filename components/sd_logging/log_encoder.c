@@ -0,0 +1,166 @@
+#include "log_encoder.h"
+#include <string.h>
+#include <stddef.h>
+#include "sys_clock.h"
+
+// Keyframe size, the largest a record can get is MAX_RECORD_SIZE
+#define BITMAP_LEN          ((LOG_FIELD_COUNT + 7) / 8)
+#define MAX_RECORD_SIZE     (1 + BITMAP_LEN + LOG_FIELD_COUNT * 5)
+
+static size_t record_size(void)
+{
+    size_t size = 1; // dt_ms
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) size += blog_type_size(log_fields[i].type);
+    return size;
+}
+
+static esp_err_t seal_block(log_encoder_t *enc, log_writer_t *w)
+{
+    if (enc->count == 0) return ESP_OK;
+
+    blog_block_header_t hdr;
+    memcpy(&hdr, enc->block, sizeof(hdr));
+    hdr.record_count = enc->count;
+    hdr.session = (uint16_t)enc->session;
+    hdr.seq = enc->seq++;
+    memcpy(enc->block, &hdr, sizeof(hdr));
+
+    memset(&enc->block[enc->used], 0, BLOG_BLOCK_SIZE - enc->used);
+    blog_block_seal(enc->block);
+
+    enc->used = 0;
+    enc->count = 0;
+    return log_writer_write(w, enc->block, BLOG_BLOCK_SIZE);
+}
+
+esp_err_t log_encoder_start(log_encoder_t *enc, log_writer_t *w, uint32_t session)
+{
+    _Static_assert(LOG_FIELD_COUNT <= BLOG_MAX_SIGNALS, "Too many logged signals");
+    _Static_assert(sizeof(blog_file_header_t) + BLOG_MAX_SIGNALS * sizeof(blog_signal_t) <= BLOG_BLOCK_SIZE,
+                   "Header must fit one block");
+
+    memset(enc, 0, sizeof(*enc));
+    enc->session = session;
+    enc->flags = SD_LOG_DELTA ? BLOG_FLAG_DELTA : 0;
+
+    blog_file_header_t hdr = {
+        .magic = BLOG_MAGIC,
+        .version = BLOG_VERSION,
+        .block_size = BLOG_BLOCK_SIZE,
+        .header_size = sizeof(blog_file_header_t) + LOG_FIELD_COUNT * sizeof(blog_signal_t),
+        .signal_count = LOG_FIELD_COUNT,
+        .record_size = record_size(),
+        .session = session,
+        .flags = enc->flags,
+    };
+    memcpy(enc->block, &hdr, sizeof(hdr));
+
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) {
+        blog_signal_t sig = {
+            .type = log_fields[i].type,
+            .exp10 = log_fields[i].exp10,
+        };
+        strncpy(sig.name, log_fields[i].name, BLOG_NAME_LEN);
+        strncpy(sig.unit, log_fields[i].unit, BLOG_UNIT_LEN);
+        memcpy(&enc->block[sizeof(hdr) + i * sizeof(sig)], &sig, sizeof(sig));
+    }
+
+    esp_err_t ret = log_writer_write(w, enc->block, BLOG_BLOCK_SIZE);
+    memset(enc->block, 0, sizeof(enc->block));
+    return ret;
+}
+
+// Full record: dt + every value packed as its disk type
+static size_t encode_keyframe(uint8_t *dst, uint8_t dt, const int32_t *vals)
+{
+    uint8_t *p = dst;
+    *p++ = dt;
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) {
+        blog_put_value(p, log_fields[i].type, vals[i]);
+        p += blog_type_size(log_fields[i].type);
+    }
+    return p - dst;
+}
+
+// Delta record: dt + change bitmap + a varint per changed value
+static size_t encode_delta(uint8_t *dst, uint8_t dt, const int32_t *vals, const int32_t *prev)
+{
+    uint8_t *bitmap = &dst[1];
+    uint8_t *p = bitmap + BITMAP_LEN;
+    dst[0] = dt;
+    memset(bitmap, 0, BITMAP_LEN);
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) {
+        if (vals[i] == prev[i]) continue;
+        bitmap[i / 8] |= 1 << (i % 8);
+        p += blog_put_varint(p, (int32_t)((uint32_t)vals[i] - (uint32_t)prev[i]));
+    }
+    return p - dst;
+}
+
+esp_err_t log_encoder_add(log_encoder_t *enc, log_writer_t *w, const sd_log_record_t *rec)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t buf[MAX_RECORD_SIZE];
+    size_t len = 0;
+
+    // Exactly what a reader gets back, deltas must be taken on these
+    int32_t vals[LOG_FIELD_COUNT];
+    for (size_t i = 0; i < LOG_FIELD_COUNT; i++) {
+        vals[i] = blog_clamp_value(log_fields[i].type, log_field_read(rec, &log_fields[i]));
+    }
+
+    // dt is one byte: a gap that doesn't fit (or time going backwards)
+    // simply starts a new block with a fresh base time
+    uint32_t dt = rec->timestamp_ms - enc->last_ms;
+    if (enc->count > 0) {
+        if (rec->timestamp_ms < enc->last_ms || dt > UINT8_MAX) {
+            ret = seal_block(enc, w);
+        } else {
+            len = (enc->flags & BLOG_FLAG_DELTA) ? encode_delta(buf, dt, vals, enc->prev)
+                                                 : encode_keyframe(buf, dt, vals);
+            if (enc->used + len > BLOG_BLOCK_SIZE - BLOG_CRC_SIZE) ret = seal_block(enc, w);
+        }
+    }
+
+    if (enc->count == 0) {
+        blog_block_header_t hdr = {
+            .sync = BLOG_SYNC,
+            .base_ms = rec->timestamp_ms,
+        };
+        memcpy(enc->block, &hdr, sizeof(hdr));
+        enc->used = sizeof(hdr);
+        enc->opened_us = sys_clock_us();
+        // Blocks must decode on their own, so each one opens with a keyframe
+        len = encode_keyframe(buf, 0, vals);
+    }
+
+    memcpy(&enc->block[enc->used], buf, len);
+    memcpy(enc->prev, vals, sizeof(vals));
+    enc->used += len;
+    enc->count++;
+    enc->last_ms = rec->timestamp_ms;
+    return ret;
+}
+
+esp_err_t log_encoder_poll(log_encoder_t *enc, log_writer_t *w)
+{
+    // Sealing on the fsync clock loses nothing extra on a power cut, and
+    // at normal sample rates lets blocks fill up before they are sealed
+    int64_t max_age_ms = SD_LOG_FSYNC_MS ? SD_LOG_FSYNC_MS : SD_LOG_FLUSH_MS;
+    if (enc->count > 0 && sys_clock_us() - enc->opened_us >= max_age_ms * 1000LL) {
+        return seal_block(enc, w);
+    }
+    return ESP_OK;
+}
+
+esp_err_t log_encoder_finish(log_encoder_t *enc, log_writer_t *w)
+{
+    esp_err_t ret = seal_block(enc, w);
+
+    // Tells recovery the file needs no scanning
+    uint32_t flags = enc->flags | BLOG_FLAG_CLOSED;
+    if (ret == ESP_OK) {
+        ret = log_writer_patch(w, offsetof(blog_file_header_t, flags), &flags, sizeof(flags));
+    }
+    return ret;
+}
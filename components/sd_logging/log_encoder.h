@@ -0,0 +1,29 @@
+#pragma once
+#include "log_format.h"
+#include "log_writer.h"
+#include "sd_logging.h"
+
+// Packs sd_log_record_t samples into CRC-sealed blocks (see log_format.h)
+// and hands every finished block to the writer. Logger task only.
+// With SD_LOG_DELTA each block opens with a full keyframe record followed
+// by delta records.
+typedef struct {
+    uint8_t block[BLOG_BLOCK_SIZE];
+    size_t used;            // Bytes of the block filled so far
+    uint16_t count;         // Records in the open block
+    uint32_t last_ms;       // Timestamp of the last record
+    int64_t opened_us;      // When the open block got its first record
+    uint32_t session;
+    uint32_t seq;           // Number of the next sealed block
+    uint32_t flags;         // File header flags, BLOG_FLAG_CLOSED is added on finish
+    int32_t prev[BLOG_MAX_SIGNALS]; // Last stored values, the base for deltas
+} log_encoder_t;
+
+// Writes the file header block describing every logged signal
+esp_err_t log_encoder_start(log_encoder_t *enc, log_writer_t *w, uint32_t session);
+esp_err_t log_encoder_add(log_encoder_t *enc, log_writer_t *w, const sd_log_record_t *rec);
+// Seals the open block early once it is older than the fsync period, so
+// the writer's fsync really bounds how much a power cut can lose
+esp_err_t log_encoder_poll(log_encoder_t *enc, log_writer_t *w);
+// Seals the open block, if any, and marks the file as cleanly closed
+esp_err_t log_encoder_finish(log_encoder_t *enc, log_writer_t *w);
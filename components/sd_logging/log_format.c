@@ -0,0 +1,188 @@
+#include "log_format.h"
+#include <string.h>
+
+static uint32_t crc_table[256];
+static bool crc_ready = false;
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+    crc_ready = true;
+}
+
+uint32_t blog_crc32(uint32_t crc, const void *data, size_t len)
+{
+    if (!crc_ready) crc_init();
+
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+size_t blog_type_size(uint8_t type)
+{
+    switch (type) {
+        case BLOG_U8:  case BLOG_I8:  return 1;
+        case BLOG_U16: case BLOG_I16: return 2;
+        case BLOG_U32: case BLOG_I32: case BLOG_F32: return 4;
+    }
+    return 0;
+}
+
+static int32_t clamp(int32_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+int32_t blog_clamp_value(uint8_t type, int32_t value)
+{
+    switch (type) {
+        case BLOG_U8:  return clamp(value, 0, UINT8_MAX);
+        case BLOG_I8:  return clamp(value, INT8_MIN, INT8_MAX);
+        case BLOG_U16: return clamp(value, 0, UINT16_MAX);
+        case BLOG_I16: return clamp(value, INT16_MIN, INT16_MAX);
+    }
+    return value;
+}
+
+void blog_put_value(uint8_t *dst, uint8_t type, int32_t value)
+{
+    uint32_t u;
+    switch (type) {
+        case BLOG_U8:  dst[0] = (uint8_t)clamp(value, 0, UINT8_MAX); return;
+        case BLOG_I8:  dst[0] = (uint8_t)(int8_t)clamp(value, INT8_MIN, INT8_MAX); return;
+        case BLOG_U16: u = (uint32_t)clamp(value, 0, UINT16_MAX); break;
+        case BLOG_I16: u = (uint16_t)(int16_t)clamp(value, INT16_MIN, INT16_MAX); break;
+        case BLOG_U32: case BLOG_I32: u = (uint32_t)value; break;
+        default: return;
+    }
+    dst[0] = u & 0xFF;
+    dst[1] = (u >> 8) & 0xFF;
+    if (blog_type_size(type) == 4) {
+        dst[2] = (u >> 16) & 0xFF;
+        dst[3] = (u >> 24) & 0xFF;
+    }
+}
+
+int32_t blog_get_value(const uint8_t *src, uint8_t type)
+{
+    switch (type) {
+        case BLOG_U8:  return src[0];
+        case BLOG_I8:  return (int8_t)src[0];
+        case BLOG_U16: return (uint16_t)(src[0] | (src[1] << 8));
+        case BLOG_I16: return (int16_t)(src[0] | (src[1] << 8));
+        case BLOG_U32: case BLOG_I32:
+            return (int32_t)((uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+                             ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24));
+    }
+    return 0;
+}
+
+void blog_block_seal(uint8_t *block)
+{
+    uint32_t crc = blog_crc32(0, block, BLOG_BLOCK_SIZE - BLOG_CRC_SIZE);
+    blog_put_value(&block[BLOG_BLOCK_SIZE - BLOG_CRC_SIZE], BLOG_U32, (int32_t)crc);
+}
+
+bool blog_block_valid(const uint8_t *block)
+{
+    blog_block_header_t hdr;
+    memcpy(&hdr, block, sizeof(hdr));
+    if (hdr.sync != BLOG_SYNC) return false;
+
+    uint32_t crc = blog_crc32(0, block, BLOG_BLOCK_SIZE - BLOG_CRC_SIZE);
+    return (uint32_t)blog_get_value(&block[BLOG_BLOCK_SIZE - BLOG_CRC_SIZE], BLOG_U32) == crc;
+}
+
+bool blog_block_in_sequence(const uint8_t *block, uint32_t session, uint32_t seq)
+{
+    blog_block_header_t hdr;
+    memcpy(&hdr, block, sizeof(hdr));
+    return hdr.seq == seq && hdr.session == (uint16_t)session && blog_block_valid(block);
+}
+
+size_t blog_put_varint(uint8_t *dst, int32_t value)
+{
+    uint32_t z = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t n = 0;
+    while (z >= 0x80) {
+        dst[n++] = (uint8_t)(z | 0x80);
+        z >>= 7;
+    }
+    dst[n++] = (uint8_t)z;
+    return n;
+}
+
+size_t blog_get_varint(const uint8_t *src, const uint8_t *end, int32_t *value)
+{
+    uint32_t z = 0;
+    for (size_t n = 0; n < 5 && src + n < end; n++) {
+        z |= (uint32_t)(src[n] & 0x7F) << (7 * n);
+        if (!(src[n] & 0x80)) {
+            *value = (int32_t)((z >> 1) ^ (0u - (z & 1)));
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+bool blog_signals_valid(const blog_file_header_t *hdr, const blog_signal_t *sig)
+{
+    if (hdr->signal_count > BLOG_MAX_SIGNALS) return false;
+    size_t size = 1;
+    for (int i = 0; i < hdr->signal_count; i++) {
+        size_t n = blog_type_size(sig[i].type);
+        if (n == 0) return false;
+        size += n;
+    }
+    return size == hdr->record_size;
+}
+
+int blog_decode_block(const blog_file_header_t *hdr, const blog_signal_t *sig,
+                      const uint8_t *block, blog_record_fn fn, void *ctx)
+{
+    blog_block_header_t bh;
+    memcpy(&bh, block, sizeof(bh));
+    const uint8_t *p = block + sizeof(bh);
+    const uint8_t *end = block + BLOG_BLOCK_SIZE - BLOG_CRC_SIZE;
+    bool delta = (hdr->flags & BLOG_FLAG_DELTA) != 0;
+    size_t bitmap_len = (hdr->signal_count + 7) / 8;
+    uint32_t t_ms = bh.base_ms;
+    int32_t vals[BLOG_MAX_SIGNALS];
+
+    for (int r = 0; r < bh.record_count; r++) {
+        if (p >= end) return -1;
+        t_ms += *p++;
+
+        if (r == 0 || !delta) {
+            if (p + hdr->record_size - 1 > end) return -1;
+            for (int i = 0; i < hdr->signal_count; i++) {
+                vals[i] = blog_get_value(p, sig[i].type);
+                p += blog_type_size(sig[i].type);
+            }
+        } else {
+            const uint8_t *bitmap = p;
+            p += bitmap_len;
+            if (p > end) return -1;
+            for (int i = 0; i < hdr->signal_count; i++) {
+                if (!(bitmap[i / 8] & (1 << (i % 8)))) continue;
+                int32_t d;
+                size_t n = blog_get_varint(p, end, &d);
+                if (n == 0) return -1;
+                vals[i] = (int32_t)((uint32_t)vals[i] + (uint32_t)d);
+                p += n;
+            }
+        }
+        fn(ctx, t_ms, vals);
+    }
+    return bh.record_count;
+}
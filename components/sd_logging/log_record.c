@@ -0,0 +1,35 @@
+#include "log_record.h"
+#include "log_format.h"
+#include <math.h>
+
+#define FIELD(n, u, t, e, st, member) { n, u, t, e, st, offsetof(sd_log_record_t, member) }
+
+const log_field_t log_fields[LOG_FIELD_COUNT] = {
+    FIELD("RPM",       "rpm",  BLOG_U16,  0, BLOG_U16, rpm),
+    FIELD("Speed_KPH", "km/h", BLOG_U8,   0, BLOG_U16, speed),
+    FIELD("Fuel_Pct",  "%",    BLOG_U8,   0, BLOG_U16, fuel),
+    FIELD("Volts",     "V",    BLOG_U16, -2, BLOG_F32, voltage),
+    FIELD("CVT_Temp",  "C",    BLOG_U8,   0, BLOG_U8,  cvt_temp),
+    FIELD("Eng_Temp",  "C",    BLOG_U8,   0, BLOG_U8,  eng_temp),
+    FIELD("Roll",      "deg",  BLOG_I16, -1, BLOG_I16, roll),
+    FIELD("Pitch",     "deg",  BLOG_I16, -1, BLOG_I16, pitch),
+    FIELD("Box",       "",     BLOG_U8,   0, BLOG_U8,  box_call),
+};
+
+int32_t log_field_read(const sd_log_record_t *rec, const log_field_t *f)
+{
+    const uint8_t *src = (const uint8_t *)rec + f->offset;
+    switch (f->src_type) {
+        case BLOG_U8:  return *(const uint8_t *)src;
+        case BLOG_U16: return *(const uint16_t *)src;
+        case BLOG_I16: return *(const int16_t *)src;
+        case BLOG_U32: return (int32_t)*(const uint32_t *)src;
+        case BLOG_F32: {
+            // Fixed point, e.g. volts with exp10 = -2 are stored as centivolts
+            float v = *(const float *)src;
+            for (int8_t e = f->exp10; e < 0; e++) v *= 10.0f;
+            return (int32_t)lroundf(v);
+        }
+    }
+    return 0;
+}
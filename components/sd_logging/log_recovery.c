@@ -0,0 +1,107 @@
+#include "log_recovery.h"
+#include "log_format.h"
+#include "sd_logging.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/unistd.h>
+#include "esp_log.h"
+
+static const char *TAG = "SD_RECOVERY";
+
+#define RECOVERY_LOOKAHEAD  4   // Chunks probed past the end of the prefix
+
+static bool read_block(FILE *f, uint64_t offset, uint8_t *block)
+{
+    return fseek(f, offset, SEEK_SET) == 0 && fread(block, 1, BLOG_BLOCK_SIZE, f) == BLOG_BLOCK_SIZE;
+}
+
+esp_err_t log_recover_file(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) return ESP_ERR_NOT_FOUND;
+
+    FILE *f = fopen(path, "r+");
+    if (f == NULL) return ESP_FAIL;
+    setvbuf(f, NULL, _IONBF, 0);
+
+    uint8_t block[BLOG_BLOCK_SIZE];
+    blog_file_header_t hdr;
+    if (!read_block(f, 0, block)) {
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&hdr, block, sizeof(hdr));
+    if (memcmp(hdr.magic, BLOG_MAGIC, sizeof(hdr.magic)) != 0 &&
+        memcmp(hdr.magic, BCAN_MAGIC, sizeof(hdr.magic)) != 0) {
+        fclose(f);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (hdr.flags & BLOG_FLAG_CLOSED) {
+        fclose(f);
+        return ESP_OK;
+    }
+
+    // Data block seq lives at file block seq + 1 and the writer fills the
+    // file front to back, so "block b is in sequence" holds for a prefix of
+    // the file and nothing after it. Bisect on chunk heads, then walk the
+    // blocks of the last good chunk: O(log n) sector reads, not the file.
+    const uint64_t per_chunk = SD_LOG_BUFFER_SIZE / BLOG_BLOCK_SIZE;
+    uint64_t n_blocks = st.st_size / BLOG_BLOCK_SIZE;
+    uint64_t n_chunks = (n_blocks + per_chunk - 1) / per_chunk;
+    uint32_t reads = 1;
+
+    // Chunk 0 starts with the file header, the search starts after it
+    uint64_t lo = 0, hi = n_chunks;
+    while (true) {
+        // Invariant: chunk lo is good (or 0), chunks from hi on are not
+        while (hi - lo > 1) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            reads++;
+            if (read_block(f, mid * SD_LOG_BUFFER_SIZE, block) &&
+                blog_block_in_sequence(block, hdr.session, mid * per_chunk - 1)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        // A chunk lost to a failed write would end the prefix early, look
+        // a few chunks past it before giving up on the rest of the file
+        uint64_t next = 0;
+        for (uint64_t c = hi + 1; c < n_chunks && c <= hi + RECOVERY_LOOKAHEAD; c++) {
+            reads++;
+            if (read_block(f, c * SD_LOG_BUFFER_SIZE, block) &&
+                blog_block_in_sequence(block, hdr.session, c * per_chunk - 1)) {
+                next = c;
+                break;
+            }
+        }
+        if (next == 0) break;
+        lo = next;
+        hi = n_chunks;
+    }
+
+    uint64_t b = (lo == 0) ? 1 : lo * per_chunk;
+    while (b < n_blocks && b < (lo + 1) * per_chunk) {
+        reads++;
+        if (!read_block(f, b * BLOG_BLOCK_SIZE, block) || !blog_block_in_sequence(block, hdr.session, b - 1)) break;
+        b++;
+    }
+    uint64_t end = b * BLOG_BLOCK_SIZE;
+    uint64_t size = st.st_size;
+
+    esp_err_t ret = ESP_OK;
+    if (ftruncate(fileno(f), end) != 0) {
+        ESP_LOGE(TAG, "Failed to truncate %s", path);
+        ret = ESP_FAIL;
+    } else {
+        // Mark it so the next boot doesn't scan it again
+        hdr.flags |= BLOG_FLAG_CLOSED;
+        fseek(f, offsetof(blog_file_header_t, flags), SEEK_SET);
+        fwrite(&hdr.flags, 1, sizeof(hdr.flags), f);
+        ESP_LOGW(TAG, "Recovered %s: %llu of %llu bytes kept (%lu sector reads)", path, end, size, reads);
+    }
+    fclose(f);
+    return ret;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "esp_err.h"
+
+// Cuts a block-format log (log_N.bin / can_N.bin) that was not closed
+// cleanly back to its last in-sequence block, dropping torn writes and the
+// preallocated tail. Bisects on block sequence numbers, so a 64 MB file
+// costs a few dozen sector reads. Files already marked BLOG_FLAG_CLOSED are
+// left alone after one read.
+esp_err_t log_recover_file(const char *path);
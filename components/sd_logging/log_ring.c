@@ -0,0 +1,66 @@
+#include "log_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+esp_err_t log_ring_init(log_ring_t *r, size_t elem_size, uint32_t capacity, log_ring_overflow_t policy)
+{
+    // Power of two so indexes wrap with a mask and free-running counters
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) return ESP_ERR_INVALID_ARG;
+
+    r->buf = calloc(capacity, elem_size);
+    if (r->buf == NULL) return ESP_ERR_NO_MEM;
+
+    r->elem_size = elem_size;
+    r->mask = capacity - 1;
+    r->policy = policy;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->dropped, 0);
+    return ESP_OK;
+}
+
+void log_ring_free(log_ring_t *r)
+{
+    free(r->buf);
+    r->buf = NULL;
+}
+
+bool log_ring_push(log_ring_t *r, const void *elem)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    if (head - tail > r->mask) {
+        if (r->policy == LOG_RING_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        // Single attempt: if it fails the consumer just freed a slot for us
+        if (atomic_compare_exchange_strong_explicit(&r->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        }
+    }
+
+    memcpy(&r->buf[(head & r->mask) * r->elem_size], elem, r->elem_size);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool log_ring_pop(log_ring_t *r, void *elem)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    while (1) {
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (tail == head) return false;
+
+        memcpy(elem, &r->buf[(tail & r->mask) * r->elem_size], r->elem_size);
+
+        // In DROP_OLDEST the producer may have discarded (and overwritten)
+        // this slot while we copied it; the CAS tells us, and reloads tail
+        if (atomic_compare_exchange_strong_explicit(&r->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include "log_session.h"
+#include "sd_logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "SD_SESSION";
+
+#define NVS_NAMESPACE   "sd_logging"
+#define NVS_KEY         "next_session"
+#define INDEX_FILE      MOUNT_POINT "/SESSION.IDX" // 8.3, long names are off
+#define PREV_LOOKBACK   8   // Numbers log_session_prev() checks below this one
+
+static bool nvs_read(uint32_t *out)
+{
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+    bool ok = (nvs_get_u32(h, NVS_KEY, out) == ESP_OK);
+    nvs_close(h);
+    return ok;
+}
+
+static void nvs_write(uint32_t next)
+{
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_set_u32(h, NVS_KEY, next) == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+}
+
+static bool index_read(uint32_t *out)
+{
+    FILE *f = fopen(INDEX_FILE, "r");
+    if (f == NULL) return false;
+    unsigned long v;
+    bool ok = (fscanf(f, "%lu", &v) == 1);
+    fclose(f);
+    if (ok) *out = v;
+    return ok;
+}
+
+static void index_write(uint32_t next)
+{
+    FILE *f = fopen(INDEX_FILE, "w");
+    if (f == NULL) return;
+    fprintf(f, "%lu\n", (unsigned long)next);
+    fclose(f);
+}
+
+// Matches log_N.* / can_N.* (FAT may hand names back in upper case)
+static bool parse_session(const char *name, uint32_t *out)
+{
+    if (strncasecmp(name, "log_", 4) != 0 && strncasecmp(name, "can_", 4) != 0) return false;
+    char *end;
+    unsigned long v = strtoul(name + 4, &end, 10);
+    if (end == name + 4 || *end != '.') return false;
+    *out = v;
+    return true;
+}
+
+// One pass over the directory, the fallback when the counters disagree
+static uint32_t scan_next(void)
+{
+    uint32_t next = 0;
+    DIR *dir = opendir(MOUNT_POINT);
+    if (dir == NULL) return 0;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        uint32_t n;
+        if (parse_session(ent->d_name, &n) && n + 1 > next) next = n + 1;
+    }
+    closedir(dir);
+    return next;
+}
+
+static bool session_used(uint32_t n)
+{
+    char path[32];
+    struct stat st;
+    sprintf(path, "%s/log_%lu.%s", MOUNT_POINT, (unsigned long)n,
+            (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) ? "bin" : "csv");
+    return stat(path, &st) == 0;
+}
+
+uint32_t log_session_next(void)
+{
+    uint32_t from_nvs = 0, from_index = 0, session;
+    bool nvs_ok = nvs_read(&from_nvs);
+    bool index_ok = index_read(&from_index);
+
+    if (nvs_ok && index_ok && from_nvs == from_index && !session_used(from_nvs)) {
+        session = from_nvs;
+    } else {
+        session = scan_next();
+        ESP_LOGW(TAG, "Session counters out of sync (nvs %s %lu, card %s %lu), scanned: %lu",
+                 nvs_ok ? "=" : "missing", (unsigned long)from_nvs,
+                 index_ok ? "=" : "missing", (unsigned long)from_index, (unsigned long)session);
+    }
+
+    // Reserve it before anything is written, a crash can't reuse the number
+    index_write(session + 1);
+    nvs_write(session + 1);
+    return session;
+}
+
+bool log_session_prev(uint32_t next, uint32_t *prev)
+{
+    for (uint32_t n = next; n > 0 && next - n < PREV_LOOKBACK; n--) {
+        if (session_used(n - 1)) {
+            *prev = n - 1;
+            return true;
+        }
+    }
+    return false;
+}
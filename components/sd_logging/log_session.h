@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Picks this boot's session number (the N in log_N / can_N) and reserves it.
+// Normally one NVS read, one small file read and one stat(), whatever the
+// number of files on the card. NVS and the card's index file cross-check
+// each other; if they disagree (new card, card used in another car, first
+// boot) one readdir pass finds the highest N instead.
+uint32_t log_session_next(void);
+
+// Newest session below next that left a log on the card. A number reserved
+// but never opened (power lost in between) is stepped over; only the few
+// numbers below next are checked, one stat() each
+bool log_session_prev(uint32_t next, uint32_t *prev);
@@ -0,0 +1,85 @@
+#include "log_stats.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "sys_clock.h"
+#include "can_id_stats.h"
+
+static const char *TAG = "SD_STATS";
+
+sd_log_stats_t log_stats;
+
+void log_stats_reset(void)
+{
+    memset(&log_stats, 0, sizeof(log_stats));
+}
+
+static void dump_hist(FILE *f, const char *name, const uint32_t *hist)
+{
+    fprintf(f, "%s_us:\n", name);
+    for (int i = 0; i < SD_STATS_BUCKETS; i++) {
+        if (hist[i] == 0) continue;
+        if (i == SD_STATS_BUCKETS - 1) fprintf(f, "  >=%lu: %lu\n", 1UL << i, hist[i]);
+        else fprintf(f, "  %lu-%lu: %lu\n", 1UL << i, (2UL << i) - 1, hist[i]);
+    }
+}
+
+static void dump_can_health(FILE *f)
+{
+    can_health_t h;
+    can_get_health(&h);
+    fprintf(f, "can_state: %u\n", h.state);
+    fprintf(f, "can_error_counters: tx %lu (max %lu), rx %lu (max %lu)\n", h.tx_err, h.tx_err_max,
+            h.rx_err, h.rx_err_max);
+    fprintf(f, "can_rx_queue_high_water: %lu/%d\n", h.rx_queued_max, CAN_RX_QUEUE_LEN);
+    fprintf(f, "can_tx_queue_high_water: %lu\n", h.tx_queued_max);
+    fprintf(f, "can_rx_missed: %lu\n", h.rx_missed);
+    fprintf(f, "can_rx_overrun: %lu\n", h.rx_overrun);
+    fprintf(f, "can_arb_lost: %lu\n", h.arb_lost);
+    fprintf(f, "can_bus_errors: %lu\n", h.bus_error);
+    fprintf(f, "can_tx_failed: %lu\n", h.tx_failed);
+    fprintf(f, "can_bus_off: %lu\n", h.bus_off);
+}
+
+// Per ID traffic from the CAN layer, one line each
+static void dump_can_ids(FILE *f)
+{
+    static const char *status_names[] = { "ok", "missing", "off_period" };
+    static can_id_stat_t ids[CAN_ID_STATS_LEN];     // Logger task only, keep it off its stack
+    int n = can_id_stats_get(ids, CAN_ID_STATS_LEN);
+    int64_t now_us = sys_clock_us();
+
+    fprintf(f, "can_ids: %d, overflow %lu\n", n, can_id_stats_overflow());
+    for (int i = 0; i < n; i++) {
+        const can_id_stat_t *e = &ids[i];
+        int64_t age_ms = e->count ? (now_us - e->last_us) / 1000 : -1;
+        fprintf(f, "  %lX%s: count %lu, mean_us %lu, avg_us %lu, max_us %lu, jitter_us %lu, "
+                   "age_ms %lld, expected_ms %u, %s\n",
+                e->id & ~CAN_ID_EXTD, (e->id & CAN_ID_EXTD) ? "x" : "", e->count, can_id_mean_us(e),
+                e->avg_us, e->max_us, e->jitter_us, age_ms, e->expected_ms,
+                status_names[can_id_check(e, now_us)]);
+    }
+}
+
+void log_stats_dump(const char *path, const sd_log_stats_t *stats)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        ESP_LOGW(TAG, "Failed to open %s", path);
+        return;
+    }
+    fprintf(f, "spi_khz: %lu\n", stats->spi_khz);
+    fprintf(f, "bytes_written: %llu\n", stats->bytes_written);
+    fprintf(f, "write_errors: %lu\n", stats->write_errors);
+    fprintf(f, "write_max_us: %lu\n", stats->write_max_us);
+    fprintf(f, "sync_max_us: %lu\n", stats->sync_max_us);
+    fprintf(f, "log_ring_high_water: %lu/%d\n", stats->log_ring_high_water, SD_LOG_RING_LEN);
+    fprintf(f, "can_ring_high_water: %lu/%d\n", stats->can_ring_high_water, SD_CAN_RING_LEN);
+    fprintf(f, "log_dropped: %lu\n", stats->log_dropped);
+    fprintf(f, "can_dropped: %lu\n", stats->can_dropped);
+    dump_hist(f, "write", stats->write_hist);
+    dump_hist(f, "sync", stats->sync_hist);
+    dump_can_health(f);
+    dump_can_ids(f);
+    fclose(f);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "sd_logging.h"
+
+// Logger health counters. Only the logger task writes them, and only per
+// card operation or per task period, never per record.
+extern sd_log_stats_t log_stats;
+
+static inline void log_stats_record(uint32_t *hist, uint32_t *max_us, int64_t us)
+{
+    uint32_t v = (us > 0) ? (uint32_t)us : 1;
+    int bucket = 31 - __builtin_clz(v);
+    if (bucket >= SD_STATS_BUCKETS) bucket = SD_STATS_BUCKETS - 1;
+    hist[bucket]++;
+    if (v > *max_us) *max_us = v;
+}
+
+static inline void log_stats_high_water(uint32_t *hw, uint32_t count)
+{
+    if (count > *hw) *hw = count;
+}
+
+void log_stats_reset(void);
+// Writes the current stats as text, overwriting path
+void log_stats_dump(const char *path, const sd_log_stats_t *stats);
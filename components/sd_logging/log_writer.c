@@ -0,0 +1,204 @@
+#include "log_writer.h"
+#include "sd_logging.h"
+#include <string.h>
+#include <sys/unistd.h>
+#include "esp_log.h"
+#include "sys_clock.h"
+#include "esp_heap_caps.h"
+#include "esp_vfs_fat.h"
+#include "sd_clock.h"
+#include "log_stats.h"
+
+static const char *TAG = "SD_WRITER";
+
+esp_err_t log_writer_open(log_writer_t *w, const char *path, uint64_t prealloc_bytes)
+{
+    memset(w, 0, sizeof(*w));
+
+    w->buf = heap_caps_aligned_alloc(4, SD_LOG_BUFFER_SIZE, MALLOC_CAP_DMA);
+    if (w->buf == NULL) {
+        ESP_LOGE(TAG, "No memory for %d byte write buffer", SD_LOG_BUFFER_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+    w->buf_size = SD_LOG_BUFFER_SIZE;
+    strncpy(w->path, path, sizeof(w->path) - 1);
+
+    if (prealloc_bytes > 0) {
+        // Round up to whole chunks so the last one is reserved too
+        prealloc_bytes = (prealloc_bytes + w->buf_size - 1) / w->buf_size * w->buf_size;
+        esp_err_t ret = esp_vfs_fat_create_contiguous_file(MOUNT_POINT, path, prealloc_bytes, true);
+        if (ret == ESP_OK) {
+            w->prealloc = prealloc_bytes;
+            w->f = fopen(path, "r+");
+        } else {
+            // Fragmented or full card: still log, just with FAT allocation on the way
+            ESP_LOGW(TAG, "No contiguous %llu KB for %s (%s)", prealloc_bytes / 1024, path, esp_err_to_name(ret));
+        }
+    }
+    if (w->f == NULL && w->prealloc == 0) {
+        w->f = fopen(path, "w");
+    }
+    if (w->f == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        heap_caps_free(w->buf);
+        w->buf = NULL;
+        return ESP_FAIL;
+    }
+
+    // We do our own chunking, stdio buffering would only split our writes
+    setvbuf(w->f, NULL, _IONBF, 0);
+
+    w->last_flush_us = sys_clock_us();
+    w->last_sync_us = w->last_flush_us;
+    return ESP_OK;
+}
+
+// Writes the current chunk at its file offset
+static esp_err_t write_chunk(log_writer_t *w)
+{
+    size_t len = w->fill;
+    if (w->prealloc) {
+        // Full chunk every time, the zeros get overwritten by the next flush
+        memset(&w->buf[w->fill], 0, w->buf_size - w->fill);
+        len = w->buf_size;
+        if (w->chunk_offset + len > w->prealloc && w->chunk_offset < w->prealloc) {
+            ESP_LOGW(TAG, "Preallocated region full, file grows from here");
+        }
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int64_t start = sys_clock_us();
+        if (fseek(w->f, w->chunk_offset, SEEK_SET) == 0 &&
+            fwrite(w->buf, 1, len, w->f) == len) {
+            log_stats_record(log_stats.write_hist, &log_stats.write_max_us, sys_clock_us() - start);
+            log_stats.bytes_written += len;
+            return ESP_OK;
+        }
+        log_stats.write_errors++;
+        // Most likely a CRC error on a marginal wire: slow the bus down and
+        // retry. FatFs refuses any further access to a file that saw a disk
+        // error, so it has to be reopened
+        ESP_LOGE(TAG, "Write failed at offset %llu", w->chunk_offset);
+        sd_clock_report_error();
+        fclose(w->f);
+        w->f = fopen(w->path, "r+");
+        if (w->f == NULL) {
+            ESP_LOGE(TAG, "Failed to reopen %s", w->path);
+            return ESP_FAIL;
+        }
+        setvbuf(w->f, NULL, _IONBF, 0);
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t log_writer_write(log_writer_t *w, const void *data, size_t len)
+{
+    if (w->f == NULL) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = ESP_OK;
+    const uint8_t *src = data;
+    while (len > 0) {
+        size_t n = w->buf_size - w->fill;
+        if (n > len) n = len;
+        memcpy(&w->buf[w->fill], src, n);
+        w->fill += n;
+        w->pending += n;
+        src += n;
+        len -= n;
+
+        // Chunk complete, it goes out as one aligned write and is never touched again
+        if (w->fill == w->buf_size) {
+            if (write_chunk(w) != ESP_OK) ret = ESP_FAIL;
+            w->chunk_offset += w->buf_size;
+            w->fill = 0;
+            w->unsynced += w->pending;
+            w->pending = 0;
+        }
+    }
+    if (ret != ESP_OK) return ret;
+    return log_writer_poll(w);
+}
+
+esp_err_t log_writer_patch(log_writer_t *w, uint64_t offset, const void *data, size_t len)
+{
+    if (w->f == NULL) return ESP_ERR_INVALID_STATE;
+    if (offset + len > log_writer_length(w)) return ESP_ERR_INVALID_ARG;
+
+    // Still in RAM, the next flush carries it
+    if (offset >= w->chunk_offset) {
+        memcpy(&w->buf[offset - w->chunk_offset], data, len);
+        w->pending += len;
+        return ESP_OK;
+    }
+    if (fseek(w->f, offset, SEEK_SET) != 0 || fwrite(data, 1, len, w->f) != len) {
+        ESP_LOGE(TAG, "Patch failed");
+        return ESP_FAIL;
+    }
+    w->unsynced += len;
+    log_stats.bytes_written += len;
+    return ESP_OK;
+}
+
+esp_err_t log_writer_poll(log_writer_t *w)
+{
+    if (w->f == NULL) return ESP_ERR_INVALID_STATE;
+
+    int64_t now = sys_clock_us();
+    bool flush_due = (w->pending >= SD_LOG_FLUSH_BYTES) ||
+                     (w->pending > 0 && now - w->last_flush_us >= SD_LOG_FLUSH_MS * 1000LL);
+    bool sync_due = (SD_LOG_FSYNC_MS == 0) ||
+                    (now - w->last_sync_us >= SD_LOG_FSYNC_MS * 1000LL);
+
+    // Full chunks went out on their own, they may still need a sync
+    if (!flush_due) {
+        return (sync_due && w->unsynced > 0) ? log_writer_flush(w, true) : ESP_OK;
+    }
+
+    // fsync updates the FAT and directory entry, this is what bounds the
+    // loss on a power cut, so it runs on its own (slower) clock
+    return log_writer_flush(w, sync_due);
+}
+
+esp_err_t log_writer_flush(log_writer_t *w, bool sync)
+{
+    if (w->f == NULL) return ESP_ERR_INVALID_STATE;
+
+    int64_t now = sys_clock_us();
+    if (w->pending > 0 && w->fill > 0) {
+        if (write_chunk(w) != ESP_OK) return ESP_FAIL;
+    }
+    w->unsynced += w->pending;
+    w->pending = 0;
+    w->last_flush_us = now;
+
+    if (sync && w->unsynced > 0) {
+        int64_t start = sys_clock_us();
+        if (fsync(fileno(w->f)) != 0) {
+            ESP_LOGE(TAG, "Sync failed");
+            log_stats.write_errors++;
+            return ESP_FAIL;
+        }
+        log_stats_record(log_stats.sync_hist, &log_stats.sync_max_us, sys_clock_us() - start);
+        w->unsynced = 0;
+        w->last_sync_us = now;
+    }
+    return ESP_OK;
+}
+
+void log_writer_close(log_writer_t *w)
+{
+    if (w->f) {
+        log_writer_flush(w, false);
+        // Give back the unused part of the preallocated region
+        if (w->prealloc && ftruncate(fileno(w->f), log_writer_length(w)) != 0) {
+            ESP_LOGE(TAG, "Truncate failed");
+        }
+        fsync(fileno(w->f));
+        fclose(w->f);
+        w->f = NULL;
+    }
+    if (w->buf) {
+        heap_caps_free(w->buf);
+        w->buf = NULL;
+    }
+}
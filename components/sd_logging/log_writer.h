@@ -0,0 +1,46 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Keeps one log file open behind a cluster sized buffer and decides when
+// the buffered data is pushed to the card (flush) and committed to the
+// FAT directory entry (fsync). Not thread safe, one owner per writer.
+//
+// The card only ever sees writes that start on a chunk boundary
+// (SD_LOG_BUFFER_SIZE, one allocation unit). In preallocated mode they are
+// also always a full chunk: a flush writes the partly filled chunk padded
+// with zeros and the next flush rewrites it, so FatFs never allocates
+// clusters or read-modify-writes sectors in the middle of a session.
+typedef struct {
+    FILE *f;
+    char path[32];          // Kept to reopen the file after a card error
+    uint8_t *buf;           // Current chunk, DMA capable so FatFs writes it directly
+    size_t buf_size;
+    size_t fill;            // Bytes used in buf
+    uint64_t chunk_offset;  // File offset of buf[0]
+    uint64_t prealloc;      // Contiguous bytes reserved at open, 0 = plain append
+    size_t pending;         // Bytes written since the last flush
+    size_t unsynced;        // Bytes flushed since the last fsync
+    int64_t last_flush_us;
+    int64_t last_sync_us;
+} log_writer_t;
+
+// prealloc_bytes > 0 reserves a contiguous region up front (FatFs f_expand)
+// and switches to full-chunk writes; the file is cut to its real length
+// by log_writer_close() or, after a power cut, by log_recover_file()
+esp_err_t log_writer_open(log_writer_t *w, const char *path, uint64_t prealloc_bytes);
+esp_err_t log_writer_write(log_writer_t *w, const void *data, size_t len);
+// Overwrites bytes already written, e.g. header fields at close
+esp_err_t log_writer_patch(log_writer_t *w, uint64_t offset, const void *data, size_t len);
+// Flushes/syncs if the SD_LOG_FLUSH_* or SD_LOG_FSYNC_MS thresholds are hit
+esp_err_t log_writer_poll(log_writer_t *w);
+// Pushes the buffer to the card now, and commits it if sync is true
+esp_err_t log_writer_flush(log_writer_t *w, bool sync);
+// Real length of the data, whatever the preallocated size
+static inline uint64_t log_writer_length(const log_writer_t *w) {
+    return w->chunk_offset + w->fill;
+}
+void log_writer_close(log_writer_t *w);
@@ -0,0 +1,114 @@
+#include "sd_clock.h"
+#include "sd_logging.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "SD_CLOCK";
+
+#define TEST_FILE       MOUNT_POINT "/CLKTEST.TMP"
+#define TEST_BYTES      (SD_SPI_TEST_SECTORS * 512)
+
+static const uint32_t steps_khz[] = SD_SPI_STEPS_KHZ;
+#define STEP_COUNT (sizeof(steps_khz) / sizeof(steps_khz[0]))
+
+static sdmmc_card_t *s_card = NULL;
+static int s_step = 0;
+
+static esp_err_t set_step(int step)
+{
+    esp_err_t ret = s_card->host.set_card_clk(s_card->host.slot, steps_khz[step]);
+    if (ret == ESP_OK) s_step = step;
+    return ret;
+}
+
+// Raw sectors against a reference read at a known good speed. With CRC on
+// (IDF enables it in SPI mode) a bad bit shows up as ESP_ERR_INVALID_CRC,
+// the compare catches anything that slips through
+static bool test_reads(const uint8_t *ref, uint8_t *buf)
+{
+    for (int pass = 0; pass < SD_SPI_TEST_PASSES; pass++) {
+        esp_err_t ret = sdmmc_read_sectors(s_card, buf, 0, SD_SPI_TEST_SECTORS);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Read failed at %lu kHz (%s)", steps_khz[s_step], esp_err_to_name(ret));
+            return false;
+        }
+        if (memcmp(ref, buf, TEST_BYTES) != 0) {
+            ESP_LOGW(TAG, "Read mismatch at %lu kHz", steps_khz[s_step]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write path through FatFs: pattern out, read back, compare
+static bool test_write(uint8_t *pattern, uint8_t *buf)
+{
+    for (int i = 0; i < TEST_BYTES; i++) pattern[i] = (uint8_t)(i * 31 + s_step);
+
+    FILE *f = fopen(TEST_FILE, "w");
+    if (f == NULL) return false;
+    setvbuf(f, NULL, _IONBF, 0);
+    bool ok = (fwrite(pattern, 1, TEST_BYTES, f) == TEST_BYTES);
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok) {
+        f = fopen(TEST_FILE, "r");
+        if (f == NULL) return false;
+        setvbuf(f, NULL, _IONBF, 0);
+        ok = (fread(buf, 1, TEST_BYTES, f) == TEST_BYTES) && memcmp(pattern, buf, TEST_BYTES) == 0;
+        fclose(f);
+    }
+    if (!ok) ESP_LOGW(TAG, "Write readback failed at %lu kHz", steps_khz[s_step]);
+    return ok;
+}
+
+esp_err_t sd_clock_negotiate(sdmmc_card_t *card)
+{
+    s_card = card;
+    s_step = 0;
+
+    uint8_t *ref = heap_caps_malloc(TEST_BYTES, MALLOC_CAP_DMA);
+    uint8_t *buf = heap_caps_malloc(TEST_BYTES, MALLOC_CAP_DMA);
+    uint8_t *pattern = heap_caps_malloc(TEST_BYTES, MALLOC_CAP_DMA);
+    if (!ref || !buf || !pattern) {
+        heap_caps_free(ref); heap_caps_free(buf); heap_caps_free(pattern);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Reference at the mount speed
+    esp_err_t ret = set_step(0);
+    if (ret == ESP_OK) ret = sdmmc_read_sectors(card, ref, 0, SD_SPI_TEST_SECTORS);
+
+    for (int step = 1; ret == ESP_OK && step < (int)STEP_COUNT; step++) {
+        int good = s_step;
+        if (set_step(step) != ESP_OK || !test_reads(ref, buf) || !test_write(pattern, buf)) {
+            // Long wires topped out, stay one step below
+            set_step(good);
+            break;
+        }
+    }
+    remove(TEST_FILE);
+
+    heap_caps_free(ref);
+    heap_caps_free(buf);
+    heap_caps_free(pattern);
+
+    ESP_LOGI(TAG, "SD SPI clock: %lu kHz", steps_khz[s_step]);
+    return ret;
+}
+
+void sd_clock_report_error(void)
+{
+    if (s_card == NULL || s_step == 0) return;
+    uint32_t was = steps_khz[s_step];
+    if (set_step(s_step - 1) == ESP_OK) {
+        ESP_LOGW(TAG, "Card errors at %lu kHz, dropping to %lu kHz", was, steps_khz[s_step]);
+    }
+}
+
+uint32_t sd_clock_khz(void)
+{
+    return steps_khz[s_step];
+}
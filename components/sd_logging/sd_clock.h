@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdmmc_cmd.h"
+
+// SD SPI clock management. The card is mounted at identification speed,
+// then sd_clock_negotiate() steps the clock up through SD_SPI_STEPS_KHZ,
+// keeping a step only if CRC-checked sector reads and a file write/readback
+// both come back clean. Not thread safe: init or logger task only.
+esp_err_t sd_clock_negotiate(sdmmc_card_t *card);
+// Call after a failed card access: drops the clock one step
+void sd_clock_report_error(void);
+uint32_t sd_clock_khz(void);
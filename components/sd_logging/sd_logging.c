@@ -1,15 +1,106 @@
 #include <string.h>
 #include <sys/unistd.h>
-#include <sys/stat.h>
 #include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sys_clock.h"
 #include "sdmmc_cmd.h"
 #include "sd_logging.h"
 #include "driver/sdspi_host.h"
+#include "log_writer.h"
+#include "log_encoder.h"
+#include "can_capture.h"
+#include "event_capture.h"
+#include "log_recovery.h"
+#include "log_session.h"
+#include "sd_clock.h"
+#include "csv_format.h"
+#include "log_stats.h"
 
 static const char *TAG = "SD_LOG";
 static sdmmc_card_t *card;
 static char current_filename[32];
+static char stats_filename[32];
 static bool is_mounted = false;
+static log_writer_t writer;
+static log_ring_t ring;
+static log_encoder_t encoder;
+static TaskHandle_t logger_task = NULL;
+static SemaphoreHandle_t logger_done = NULL;
+static volatile bool stop_requested = false;
+static volatile bool flush_requested = false;
+
+static void write_record(const sd_log_record_t *rec)
+{
+    if (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) {
+        log_encoder_add(&encoder, &writer, rec);
+        return;
+    }
+
+    // Time, RPM, Speed, Fuel, Volt, CVT, ENG, Roll, Pitch without printf
+    // Lands in the RAM buffer, the writer flushes on its own schedule
+    char line[CSV_ROW_MAX];
+    log_writer_write(&writer, line, csv_format_row(line, rec));
+}
+
+// CAN task: every received frame, fanned out to the raw captures
+static void frame_hook(const can_frame_t *frame)
+{
+    if (SD_CAN_CAPTURE) can_capture_push(frame);
+    if (SD_EVENT_CAPTURE) event_capture_push(frame);
+}
+
+static void dump_stats(void)
+{
+    sd_log_stats_t stats;
+    sd_log_get_stats(&stats);
+    log_stats_dump(stats_filename, &stats);
+}
+
+// Sole consumer of the ring and sole owner of the writer
+static void sd_logger_task(void *arg)
+{
+    sd_log_record_t rec;
+    int64_t last_dump_us = sys_clock_us();
+
+    while (!stop_requested) {
+        // Right before the drain is when the ring is fullest
+        log_stats_high_water(&log_stats.log_ring_high_water, log_ring_count(&ring));
+        while (log_ring_pop(&ring, &rec)) {
+            write_record(&rec);
+        }
+        if (flush_requested) {
+            flush_requested = false;
+            log_writer_flush(&writer, true);
+        }
+        // Time based flush even when no rows come in
+        if (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) log_encoder_poll(&encoder, &writer);
+        log_writer_poll(&writer);
+        can_capture_service();
+        event_capture_service();
+
+        // The kill switch never lets us reach deinit, keep a recent copy
+        if (sys_clock_us() - last_dump_us >= SD_STATS_DUMP_MS * 1000LL) {
+            dump_stats();
+            last_dump_us = sys_clock_us();
+        }
+        sys_clock_delay_ms(SD_LOG_TASK_PERIOD_MS);
+    }
+
+    // Drain what is left and hand over to sd_logging_deinit()
+    while (log_ring_pop(&ring, &rec)) {
+        write_record(&rec);
+    }
+    if (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) log_encoder_finish(&encoder, &writer);
+    log_writer_close(&writer);
+    can_remove_frame_hook(frame_hook);
+    can_capture_stop();
+    event_capture_stop();
+    dump_stats();
+    xSemaphoreGive(logger_done);
+    vTaskDelete(NULL);
+}
 
 esp_err_t sd_logging_init(void)
 {
@@ -20,7 +111,7 @@ esp_err_t sd_logging_init(void)
     
     sdmmc_host_t host = SDSPI_HOST_DEFAULT();
     host.slot = SPI3_HOST;
-    host.max_freq_khz = 400; // 5MHz is safe for long wires
+    host.max_freq_khz = SDMMC_FREQ_PROBING; // Mount slow, sd_clock_negotiate() speeds up
 
     spi_bus_config_t bus_cfg = {
         .mosi_io_num = SD_MOSI,
@@ -42,7 +133,7 @@ esp_err_t sd_logging_init(void)
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,
         .max_files = 5,
-        .allocation_unit_size = 16 * 1024
+        .allocation_unit_size = SD_ALLOC_UNIT_SIZE
     };
 
     sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
@@ -63,64 +154,141 @@ esp_err_t sd_logging_init(void)
 
     ESP_LOGI(TAG, "SD Card mounted successfully!");
     is_mounted = true;
+    log_stats_reset();
 
-    // Find unique filename (log_0.csv, log_1.csv...)
-    int i = 0;
-    while (1) {
-        sprintf(current_filename, "%s/log_%d.csv", MOUNT_POINT, i);
-        struct stat st;
-        if (stat(current_filename, &st) != 0) {
-            // File doesn't exist, we can use this name
-            break;
-        }
-        i++;
-    }
+    // Fastest clock the wiring can take, everything after this benefits
+    sd_clock_negotiate(card);
+
+    // Session number from NVS + card index, no per-file stat() scan
+    const char *ext = (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) ? "bin" : "csv";
+    uint32_t i = log_session_next();
+    sprintf(current_filename, "%s/log_%lu.%s", MOUNT_POINT, i, ext);
+    sprintf(stats_filename, "%s/ST%lu.TXT", MOUNT_POINT, i);     // 8.3, long names are off
     ESP_LOGI(TAG, "Logging to: %s", current_filename);
 
-    // Write Header
-    FILE *f = fopen(current_filename, "w");
-    if (f == NULL) {
+    // Last session most likely ended with the kill switch: cut its files
+    // back from the preallocated size to what was really written. Only the
+    // newest one, older sessions were recovered on the boots after them
+    uint32_t last;
+    if (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY && log_session_prev(i, &last)) {
+        char prev[32];
+        sprintf(prev, "%s/log_%lu.bin", MOUNT_POINT, last);
+        log_recover_file(prev);
+        sprintf(prev, "%s/can_%lu.bin", MOUNT_POINT, last);
+        log_recover_file(prev);
+    }
+
+    // Open once, the file stays open until sd_logging_deinit()
+    // CSV can't be recovered from a preallocated file, so it just appends
+    uint64_t prealloc = (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) ? SD_LOG_PREALLOC_MB * 1024ULL * 1024ULL : 0;
+    ret = log_writer_open(&writer, current_filename, prealloc);
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open file for writing");
+        return ret;
+    }
+    if (SD_LOG_FORMAT == SD_LOG_FORMAT_BINARY) {
+        log_encoder_start(&encoder, &writer, i);
+    } else {
+        char header[CSV_ROW_MAX];
+        log_writer_write(&writer, header, csv_format_header(header, sizeof(header)));
+    }
+    log_writer_flush(&writer, true);
+
+    ret = log_ring_init(&ring, sizeof(sd_log_record_t), SD_LOG_RING_LEN, SD_LOG_OVERFLOW);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate log ring");
+        log_writer_close(&writer);
+        return ret;
+    }
+
+    // Raw capture is best effort, the sample log works without it
+    if (SD_CAN_CAPTURE && can_capture_start(i) != ESP_OK) {
+        ESP_LOGW(TAG, "Raw CAN capture disabled");
+    }
+    if (SD_EVENT_CAPTURE && event_capture_start(i) != ESP_OK) {
+        ESP_LOGW(TAG, "Event capture disabled");
+    }
+    if (!can_add_frame_hook(frame_hook)) ESP_LOGW(TAG, "No free CAN hook, raw capture stays empty");
+
+    logger_done = xSemaphoreCreateBinary();
+    stop_requested = false;
+    if (xTaskCreatePinnedToCore(sd_logger_task, "sd_logger", SD_LOG_TASK_STACK, NULL,
+                                SD_LOG_TASK_PRIORITY, &logger_task, SD_LOG_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start logger task");
+        can_remove_frame_hook(frame_hook);
+        log_writer_close(&writer);
+        can_capture_stop();
         return ESP_FAIL;
     }
-    fprintf(f, "Time_ms,RPM,Speed_KPH,Fuel_Pct,Volts,CVT_Temp,Eng_Temp,Roll,Pitch\n");
-    fclose(f);
 
     return ESP_OK;
 }
 
 void sd_log_data(car_state_t *car, uint32_t timestamp_ms)
 {
-    if (!is_mounted) return;
+    if (logger_task == NULL) return;
 
-    // Open in Append mode ("a")
-    FILE *f = fopen(current_filename, "a");
-    if (f == NULL) {
-        ESP_LOGE(TAG, "Failed to open file for appending");
-        return;
-    }
+    sd_log_record_t rec = {
+        .timestamp_ms = timestamp_ms,
+        .rpm = car->rpm,
+        .speed = car->speed,
+        .fuel = car->fuel,
+        .roll = car->roll,
+        .pitch = car->pitch,
+        .cvt_temp = car->cvt_temp,
+        .eng_temp = car->eng_temp,
+        .box_call = car->box_alert ? 1 + car->box_alert_message : 0,
+        .voltage = car->voltage,
+    };
+    log_ring_push(&ring, &rec);
+}
 
-    // Write Data Line
-    // Format: Time, RPM, Speed, Fuel, Volt, CVT, ENG, Roll, Pitch
-    fprintf(f, "%lu,%d,%d,%d,%.2f,%d,%d,%d,%d\n",
-            timestamp_ms,
-            car->rpm,
-            car->speed,
-            car->fuel,
-            car->voltage,
-            car->cvt_temp,
-            car->eng_temp,
-            car->roll,
-            car->pitch
-    );
-
-    // Close immediately to save data in case of power loss (Baja vibration!)
-    fclose(f);
+uint32_t sd_log_dropped(void)
+{
+    return (logger_task == NULL) ? 0 : log_ring_dropped(&ring);
+}
+
+uint32_t sd_can_capture_dropped(void)
+{
+    return can_capture_dropped();
+}
+
+uint32_t sd_logging_spi_khz(void)
+{
+    return is_mounted ? sd_clock_khz() : 0;
+}
+
+void sd_log_get_stats(sd_log_stats_t *stats)
+{
+    *stats = log_stats;
+    stats->log_dropped = sd_log_dropped();
+    stats->can_dropped = sd_can_capture_dropped();
+    stats->spi_khz = sd_logging_spi_khz();
+}
+
+void sd_log_event(sd_event_t reason)
+{
+    if (SD_EVENT_CAPTURE && logger_task != NULL) event_capture_trigger(1u << reason);
+}
+
+void sd_log_flush(void)
+{
+    if (!is_mounted) return;
+    // The writer belongs to the logger task, let it do the flush
+    flush_requested = true;
 }
 
 void sd_logging_deinit(void)
 {
+    if (logger_task) {
+        stop_requested = true;
+        xSemaphoreTake(logger_done, portMAX_DELAY);
+        logger_task = NULL;
+        ESP_LOGI(TAG, "Logger stopped, %lu records dropped", log_ring_dropped(&ring));
+        log_ring_free(&ring);
+    }
     if (is_mounted) {
+        log_writer_close(&writer);
         esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
         ESP_LOGI(TAG, "Card unmounted");
         is_mounted = false;
@@ -0,0 +1,27 @@
+#pragma once
+// Framebuffer drawing only, no driver calls: builds on the host too
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Resolution
+#define SCREEN_WIDTH                128
+#define SCREEN_HEIGHT               64
+#define SSD1309_BUFFER_SIZE         1024
+
+void ssd1309_clear_buffer(uint8_t *buffer);
+
+// Graphics
+void ssd1309_draw_pixel(uint8_t *buffer, int x, int y, int color);
+void ssd1309_draw_rect(uint8_t *buffer, int x, int y, int w, int h, int color, int fill);
+void ssd1309_draw_char(uint8_t *buffer, int x, int y, char c);
+void ssd1309_draw_string(uint8_t *buffer, int x, int y, const char *format, ...);
+void ssd1309_draw_string_large(uint8_t *buffer, int x, int y, int size, const char *format, ...);
+void ssd1309_draw_line(uint8_t *buffer, int x0, int y0, int x1, int y1, int color);
+void ssd1309_draw_bitmap(uint8_t *fb, int x, int y, const uint8_t *bitmap, int w, int h, int color);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+// The one clock the firmware reads and sleeps on. On the wheel it is
+// esp_timer and the FreeRTOS tick; the host simulator backs both with a
+// virtual clock, so a whole race replays in seconds with the same frame
+// timing. FreeRTOS timeouts (queues, notifications) run on the same tick
+
+// Microseconds since boot
+int64_t sys_clock_us(void);
+
+// Milliseconds since boot
+static inline int64_t sys_clock_ms(void)
+{
+    return sys_clock_us() / 1000;
+}
+
+// Blocks the calling task, rounded down to whole ticks like vTaskDelay
+void sys_clock_delay_ms(uint32_t ms);
@@ -0,0 +1,14 @@
+#include "sys_clock.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+int64_t sys_clock_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void sys_clock_delay_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
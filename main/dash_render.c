@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <math.h>
+#include "dash_render.h"
+#include "ssd1309_gfx.h"
+
+void dash_filter_apply(dash_filter_t *f, car_state_t *car) {
+    // Apply Low-Pass Filter (EMA) to smooth needles
+    f->rpm = (FILTER_ALPHA * car->rpm) + ((1.0 - FILTER_ALPHA) * f->rpm);
+    f->fuel = (FILTER_ALPHA * car->fuel) + ((1.0 - FILTER_ALPHA) * f->fuel);
+
+    // Write smoothed values back for display
+    car->rpm = (uint16_t)f->rpm;
+    car->fuel = (uint16_t)f->fuel;
+}
+
+// Same phase as the 100 Hz tick count % 20 < 10 the wheel used before
+bool dash_blink_phase(const dash_ctx_t *ctx) {
+    return (ctx->now_us / 100000) % 2 == 0;
+}
+
+// Graphics
+
+void draw_race_timer(uint8_t *fb, int x, int y, const dash_ctx_t *ctx) {
+    int64_t diff = (ctx->now_us - ctx->race_start_us) / 1000000; // Convert micros to seconds
+
+    int hour = (diff / 3600) % 60;
+    int min = (diff / 60) % 60;
+    int sec = diff % 60;
+
+    ssd1309_draw_string(fb, x, y, "%02d:%02d:%02d",hour, min, sec);
+}
+
+// Draw Arc (Bresenham-ish approximation)
+static void draw_arc(uint8_t *fb, int cx, int cy, int r, int start_angle, int end_angle) {
+    float step = 10.0f;
+    float prev_x = -1, prev_y = -1;
+    for (float a = start_angle; a >= end_angle; a -= step) {
+        float rad = a * (3.14159f / 180.0f);
+        int x = cx + (int)(r * cos(rad));
+        int y = cy - (int)(r * sin(rad));
+        if (prev_x != -1) ssd1309_draw_line(fb, (int)prev_x, (int)prev_y, x, y, 1);
+        prev_x = x; prev_y = y;
+    }
+}
+
+void draw_dynamic_gauge(uint8_t *fb, int cx, int cy, int r, float val, float max_val, const char* label, float split_pct) {
+    int start_deg = 220; // 0% position
+    int end_deg = -40;   // 100% position
+    int total_sweep = start_deg - end_deg;
+
+    // Calculate the angle where the gauge "breaks" (e.g. at 60%)
+    int split_deg = start_deg - (int)(total_sweep * split_pct);
+
+    // Determine Visibility
+    bool unlocked = (val > (max_val * split_pct * 0.95f));
+
+    int current_visible_end = unlocked ? end_deg : split_deg;
+
+    // Draw Arc (Only the visible part)
+    draw_arc(fb, cx, cy, r, start_deg, current_visible_end);
+
+    // Draw Ticks
+    int num_ticks = 5;
+    for (int i = 0; i <= num_ticks; i++) {
+        float tick_pct = (float)i / num_ticks;
+
+        // If locked, skip ticks that are in the hidden zone
+        if (!unlocked && tick_pct > split_pct) continue;
+
+        float angle = start_deg - (tick_pct * total_sweep);
+        float rad = angle * (3.14159f / 180.0f);
+
+        int x0 = cx + (int)(r * cos(rad));
+        int y0 = cy - (int)(r * sin(rad));
+        int len = (i==0 || i==num_ticks) ? 6 : 3;
+        int x1 = cx + (int)((r - len) * cos(rad));
+        int y1 = cy - (int)((r - len) * sin(rad));
+        ssd1309_draw_line(fb, x0, y0, x1, y1, 1);
+    }
+
+    // Draw Needle
+    // Map value to angle
+    float current_angle = start_deg - ((val / max_val) * total_sweep);
+    if (current_angle > start_deg) current_angle = start_deg;
+    if (current_angle < end_deg) current_angle = end_deg;
+
+    float rad = current_angle * (3.14159f / 180.0f);
+    int tip_x = cx + (int)((r - 2) * cos(rad));
+    int tip_y = cy - (int)((r - 2) * sin(rad));
+    ssd1309_draw_line(fb, cx, cy, tip_x, tip_y, 1);
+
+    // Center Hub & Text
+    ssd1309_draw_rect(fb, cx-2, cy-2, 5, 5, 1, 1);
+
+    int txt_x = (val < 10) ? cx-3 : (val < 100) ? cx-6 : cx-9;
+    ssd1309_draw_string(fb, txt_x, cy+6, "%.0f", val);
+    ssd1309_draw_string(fb, cx-10, cy-8, label);
+}
+
+// Drawing Functions
+
+// Pilot feedback
+void draw_pilot(uint8_t *fb, const car_state_t *car, const dash_ctx_t *ctx) {
+    ssd1309_clear_buffer(fb);
+    // Big Digital Speed
+    ssd1309_draw_string_large(fb, 45, 10, 4, "%d", car->speed);
+    ssd1309_draw_string(fb, 95, 40, "km/h");
+
+    // Simple RPM Bar
+    ssd1309_draw_rect(fb, 0, 0, 128, 8, 1, 0);
+    int bar_w = (car->rpm * 126) / 3800;
+    if(bar_w > 126) bar_w = 126;
+    for(int i=2; i<bar_w; i+=2) ssd1309_draw_rect(fb, i, 2, 1, 4, 1, 1);
+
+    // Warnings
+    alert_engine_draw(fb, 0, 56, ctx->alerts, dash_blink_phase(ctx));
+
+    // Timing
+    draw_race_timer(fb, 80, 56, ctx);
+}
+
+// Heavy data mode
+void draw_engineer(uint8_t *fb, const car_state_t *car) {
+    ssd1309_clear_buffer(fb);
+    ssd1309_draw_string(fb, 0, 0, "SYSTEM: ONLINE");
+    ssd1309_draw_line(fb, 0, 10, 128, 10, 1);
+
+    ssd1309_draw_string(fb, 0,  15, "RPM:%d", car->rpm);
+    ssd1309_draw_string(fb, 65, 15, "SPD:%dkm/h", car->speed);
+    ssd1309_draw_string(fb, 0,  28, "ENG:%d C", car->eng_temp);
+    ssd1309_draw_string(fb, 65, 28, "CVT:%d C", car->cvt_temp);
+    ssd1309_draw_string(fb, 0,  41, "BAT:%.1fV", car->voltage);
+    ssd1309_draw_string(fb, 65, 41, "FUEL:%d%%", car->fuel);
+    ssd1309_draw_string(fb, 0, 54, "R:%d P:%d", car->roll, car->pitch);
+}
+
+// Adventure mode, add more data here
+void draw_adventure(uint8_t *fb, const car_state_t *car) {
+    ssd1309_clear_buffer(fb);
+    int cx = 64, cy = 32;
+    // Scale: 100 = 10.0 degrees
+    float roll_rad = (car->roll / 10.0f) * (3.14159f / 180.0f);
+    int pitch_offset = (car->pitch / 10.0f);
+
+    // Calculate Horizon Line
+    float cos_a = cos(roll_rad);
+    float sin_a = sin(roll_rad);
+    int len = 80;
+    int x0 = cx - (int)(len * cos_a);
+    int y0 = (cy + pitch_offset) + (int)(len * sin_a);
+    int x1 = cx + (int)(len * cos_a);
+    int y1 = (cy + pitch_offset) - (int)(len * sin_a);
+
+    ssd1309_draw_line(fb, x0, y0, x1, y1, 1);
+    ssd1309_draw_line(fb, 60, 0, 68, 0, 1); // Sky Ref
+    ssd1309_draw_line(fb, 44, 32, 84, 32, 1); // Wings
+
+    ssd1309_draw_string(fb, 0, 56, "P:%d", car->pitch/10);
+    ssd1309_draw_string(fb, 90, 56, "R:%d", car->roll/10);
+}
+
+// My mode, saab inspired
+// Still needs much tweaking
+void draw_night_mode(uint8_t *fb, const car_state_t *car, const dash_ctx_t *ctx) {
+    ssd1309_clear_buffer(fb);
+
+    // Speedometer (Centered Left)
+    draw_dynamic_gauge(fb, 32, 32, 28, car->speed, 55.0f, "KPH", 0.65f);
+
+    // Tachometer (Centered Right - Ghost)
+    if (car->rpm > 3400) {
+        if (dash_blink_phase(ctx)) {
+            draw_dynamic_gauge(fb, 96, 32, 28, car->rpm, 3800.0f, "RPM", 0.65f);
+        }
+    } else{
+        draw_dynamic_gauge(fb, 96, 32, 28, car->rpm, 3800.0f, "RPM", 0.65f);
+    }
+
+    // Warnings
+    alert_engine_draw(fb, 0, 56, ctx->alerts, dash_blink_phase(ctx));
+
+    draw_race_timer(fb, 80, 56, ctx);
+}
+
+// Pit-to-pilot alert, takes over the whole screen
+void draw_box_alert(uint8_t *fb, const car_state_t *car) {
+    ssd1309_clear_buffer(fb);
+    ssd1309_draw_rect(fb, 0, 0, 128, 64, 1, 0); // Warning border
+    ssd1309_draw_string_large(fb, 15, 20, 2, "BOX BOX!");
+    switch (car->box_alert_message) {
+        case CVT: ssd1309_draw_string(fb, 35, 45, "CVT ISSUE"); break;
+        case FUEL: ssd1309_draw_string(fb, 35, 45, "REFUEL"); break;
+        case BAT: ssd1309_draw_string(fb, 35, 45, "BAT SWITCH"); break;
+        default: ssd1309_draw_string(fb, 35, 45, "COME IN"); break;
+    }
+}
+
+// Dead link warning
+void draw_no_link(uint8_t *fb) {
+    ssd1309_clear_buffer(fb);
+    ssd1309_draw_rect(fb, 0, 0, 128, 64, 1, 0); // Warning border
+    ssd1309_draw_string_large(fb, 15, 20, 2, "NO LINK");
+    ssd1309_draw_string(fb, 35, 45, "CHECK ECU");
+}
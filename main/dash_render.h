@@ -0,0 +1,49 @@
+#pragma once
+// Dashboard screens, drawn into a framebuffer only. No FreeRTOS or timer
+// calls in here: everything time dependent comes in through dash_ctx_t, so
+// the same code runs on the wheel and in the host session renderer
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_management.h"
+#include "alert_engine.h"
+
+// Settings
+#define FILTER_ALPHA    0.1f  // 0.1 = Smooth/Slow, 1.0 = Instant/Jittery
+#define TIMEOUT_MS      1500  // Time before "NO DATA" error in ms
+
+// What a frame is drawn for
+typedef struct {
+    int64_t now_us;         // Frame time
+    int64_t race_start_us;  // Race timer zero
+    alert_mask_t alerts;    // Alert icons to show
+} dash_ctx_t;
+
+// Filtering (keep these as floats)
+typedef struct {
+    float rpm;
+    float fuel;
+} dash_filter_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Low-pass (EMA) on the needles, writes the smoothed values back into car
+void dash_filter_apply(dash_filter_t *f, car_state_t *car);
+
+// Shared blink phase so every warning flashes in sync (~200 ms on/off)
+bool dash_blink_phase(const dash_ctx_t *ctx);
+
+void draw_race_timer(uint8_t *fb, int x, int y, const dash_ctx_t *ctx);
+void draw_dynamic_gauge(uint8_t *fb, int cx, int cy, int r, float val, float max_val, const char* label, float split_pct);
+
+void draw_pilot(uint8_t *fb, const car_state_t *car, const dash_ctx_t *ctx);
+void draw_engineer(uint8_t *fb, const car_state_t *car);
+void draw_adventure(uint8_t *fb, const car_state_t *car);
+void draw_night_mode(uint8_t *fb, const car_state_t *car, const dash_ctx_t *ctx);
+void draw_box_alert(uint8_t *fb, const car_state_t *car);
+void draw_no_link(uint8_t *fb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,20 @@
 #include <stdio.h>
-#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/gpio.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
-#include "esp_timer.h"
+#include "sys_clock.h"
+#include "nvs_flash.h"
 #include "ssd1309_interface.h"
 #include "can_management.h"
+#include "can_id_stats.h"
+#include "can_tx.h"
+#include "alert_engine.h"
+#include "sd_logging.h"
+#include "can_replay.h"
+#include "can_stress.h"
+#include "dash_render.h"
+#include "button_input.h"
 //#include "icons.h"
 
 // Hardware configurations
@@ -14,301 +22,318 @@
 #define PIN_BUTTON      GPIO_NUM_0
 #define TAG             "DASH_MAIN"
 
-// Settings
-#define FILTER_ALPHA    0.1f  // 0.1 = Smooth/Slow, 1.0 = Instant/Jittery
-#define TIMEOUT_MS      1500  // Time before "NO DATA" error in ms
+// Settings (filter and link timeout are in dash_render.h, gesture timing
+// in button_input.h)
+#define CAN_PAGE_ROWS   5     // IDs per page on the CAN screen
+#define CAN_PAGE_MS     2000  // Time each page stays up
+#define ENG_PAGE_MS     4000  // Time the engineer data and bus pages stay up
+#define BOOT_TASK_PRIORITY  2     // Above app_main, the lanes mostly wait on buses
+#define BOOT_TASK_STACK     4096  // FAT mount and log recovery run in the SD lane
                                     
 // Different screen modes
 typedef enum {
     MODE_PILOT = 0,
     MODE_ENGINEER,
+    MODE_LOGGER,
     MODE_ADVENTURE,
     MODE_NIGHT,
     MODE_COUNT
 } dash_mode_t;
 
-static dash_mode_t current_mode = MODE_NIGHT;
+// Engineer mode pages. They flip on their own, so the CAN diagnostics
+// never cost the pilot a button press
+typedef enum {
+    ENG_PAGE_DATA = 0,
+    ENG_PAGE_CAN_IDS,   // Every ID page once, then on
+    ENG_PAGE_CAN_BUS,
+    ENG_PAGE_COUNT
+} eng_page_t;
+
+static dash_mode_t current_mode = MODE_PILOT;
 static uint8_t s_buffer[SSD1309_BUFFER_SIZE];
 static int64_t race_start_time = 0;
+static TaskHandle_t main_task = NULL;
+static i2c_master_dev_handle_t screen_handle;
+static dash_filter_t signal_filter = {0};
 
-// Filtering (keep these as floats)
-typedef struct {
-    float rpm;
-    float fuel;
-} filter_t;
-
-filter_t signal_filter = {0};
-
-// Graphics
-
-void draw_race_timer(uint8_t *fb, int x, int y) {
-    int64_t now = esp_timer_get_time();
-    int64_t diff = (now - race_start_time) / 1000000; // Convert micros to seconds
-    
-    int hour = (diff / 3600) % 60;
-    int min = (diff / 60) % 60;
-    int sec = diff % 60;
-    
-    ssd1309_draw_string(fb, x, y, "%02d:%02d:%02d",hour, min, sec);
-}
-
-// Draw Arc (Bresenham-ish approximation)
-void draw_arc(uint8_t *fb, int cx, int cy, int r, int start_angle, int end_angle) {
-    float step = 10.0f; 
-    float prev_x = -1, prev_y = -1;
-    for (float a = start_angle; a >= end_angle; a -= step) {
-        float rad = a * (3.14159f / 180.0f);
-        int x = cx + (int)(r * cos(rad));
-        int y = cy - (int)(r * sin(rad));
-        if (prev_x != -1) ssd1309_draw_line(fb, (int)prev_x, (int)prev_y, x, y, 1);
-        prev_x = x; prev_y = y;
-    }
-}
-
-void draw_dynamic_gauge(uint8_t *fb, int cx, int cy, int r, float val, float max_val, const char* label, float split_pct) {
-    int start_deg = 220; // 0% position
-    int end_deg = -40;   // 100% position
-    int total_sweep = start_deg - end_deg;
-    
-    // Calculate the angle where the gauge "breaks" (e.g. at 60%)
-    int split_deg = start_deg - (int)(total_sweep * split_pct);
-
-    // Determine Visibility
-    bool unlocked = (val > (max_val * split_pct * 0.95f)); 
-
-    int current_visible_end = unlocked ? end_deg : split_deg;
-
-    // Draw Arc (Only the visible part)
-    draw_arc(fb, cx, cy, r, start_deg, current_visible_end);
-
-    // Draw Ticks
-    int num_ticks = 5;
-    for (int i = 0; i <= num_ticks; i++) {
-        float tick_pct = (float)i / num_ticks;
-        
-        // If locked, skip ticks that are in the hidden zone
-        if (!unlocked && tick_pct > split_pct) continue;
-
-        float angle = start_deg - (tick_pct * total_sweep);
-        float rad = angle * (3.14159f / 180.0f);
-        
-        int x0 = cx + (int)(r * cos(rad));
-        int y0 = cy - (int)(r * sin(rad));
-        int len = (i==0 || i==num_ticks) ? 6 : 3;
-        int x1 = cx + (int)((r - len) * cos(rad));
-        int y1 = cy - (int)((r - len) * sin(rad));
-        ssd1309_draw_line(fb, x0, y0, x1, y1, 1);
-    }
-
-    // Draw Needle
-    // Map value to angle
-    float current_angle = start_deg - ((val / max_val) * total_sweep);
-    if (current_angle > start_deg) current_angle = start_deg;
-    if (current_angle < end_deg) current_angle = end_deg;
-
-    float rad = current_angle * (3.14159f / 180.0f);
-    int tip_x = cx + (int)((r - 2) * cos(rad));
-    int tip_y = cy - (int)((r - 2) * sin(rad));
-    ssd1309_draw_line(fb, cx, cy, tip_x, tip_y, 1);
-    
-    // Center Hub & Text
-    ssd1309_draw_rect(fb, cx-2, cy-2, 5, 5, 1, 1);
-    
-    int txt_x = (val < 10) ? cx-3 : (val < 100) ? cx-6 : cx-9;
-    ssd1309_draw_string(fb, txt_x, cy+6, "%.0f", val);
-    ssd1309_draw_string(fb, cx-10, cy-8, label);
-}
+// Screens live in dash_render.c, the host renderer draws them too
 
-// Drawing Functions
+// SD logger health, for the engineers: is the card keeping up?
+void draw_logger(uint8_t *fb) {
+    sd_log_stats_t st;
+    sd_log_get_stats(&st);
 
-// Pilot feedback
-void draw_pilot(uint8_t *fb, car_state_t *car) {
     ssd1309_clear_buffer(fb);
-    // Big Digital Speed
-    ssd1309_draw_string_large(fb, 45, 10, 4, "%d", car->speed);
-    ssd1309_draw_string(fb, 95, 40, "km/h");
-    
-    // Simple RPM Bar
-    ssd1309_draw_rect(fb, 0, 0, 128, 8, 1, 0); 
-    int bar_w = (car->rpm * 126) / 3800;
-    if(bar_w > 126) bar_w = 126;
-    for(int i=2; i<bar_w; i+=2) ssd1309_draw_rect(fb, i, 2, 1, 4, 1, 1);
-    bool show_fuel = (car->fuel < 20);
-    bool show_bat = (car->voltage < 11.8);
-    bool show_cvt = (car->cvt_temp > 90);
-    bool show_eng = (car->eng_temp > 90);
-
-    // Warnings
-
-    // Low Fuel Warning
-    if (show_fuel) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 30, 56, "F");
-            // ssd1309_draw_bitmap(fb, 30, 56, icon_fuel, 16, 16, 1); // I don't know how to draw.
-        }
+    if (st.spi_khz == 0) {
+        ssd1309_draw_string(fb, 0, 0, "SD: NO CARD");
+        return;
     }
-
-    // Low Fuel Warning
-    if (show_bat) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 20, 56, "B");
-        }
+    ssd1309_draw_string(fb, 0, 0, "SD %luk %lluKB", st.spi_khz, st.bytes_written / 1024);
+    ssd1309_draw_line(fb, 0, 10, 128, 10, 1);
+    ssd1309_draw_string(fb, 0, 13, "WR%lums SY%lums E%lu",
+                        st.write_max_us / 1000, st.sync_max_us / 1000, st.write_errors);
+    ssd1309_draw_string(fb, 0, 24, "DROP %lu/%lu HW %lu%%", st.log_dropped, st.can_dropped,
+                        st.log_ring_high_water * 100 / SD_LOG_RING_LEN);
+
+    // Write latency histogram, one bar per power of two us, log2 height
+    for (int i = 0; i < SD_STATS_BUCKETS; i++) {
+        uint32_t n = st.write_hist[i];
+        int h = n ? 32 - __builtin_clz(n) : 0;
+        if (h > 26) h = 26;
+        if (h) ssd1309_draw_rect(fb, i * 6 + 4, 63 - h, 4, h, 1, 1);
     }
+}
 
-    // Low Fuel Warning
-    if (show_cvt) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 10, 56, "T");
-        }
+// Per ID traffic, for the engineers: is every ECU still talking on time?
+// IDs in trouble come first, pages flip every CAN_PAGE_MS of shown_us when
+// there are more. Returns the number of pages
+int draw_can_ids(uint8_t *fb, int64_t now_us, int64_t shown_us) {
+    static can_id_stat_t ids[CAN_ID_STATS_LEN];
+    static const char *status_names[] = { "OK", "MISS", "OFF" };
+    int n = can_id_stats_get(ids, CAN_ID_STATS_LEN);
+
+    // Stable partition, bad IDs to the front in ID order
+    int bad = 0;
+    for (int i = 0; i < n; i++) {
+        if (can_id_check(&ids[i], now_us) == CAN_ID_OK) continue;
+        can_id_stat_t e = ids[i];
+        for (int j = i; j > bad; j--) ids[j] = ids[j - 1];
+        ids[bad++] = e;
     }
 
-    if (show_eng) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 0, 56, "E");
+    ssd1309_clear_buffer(fb);
+    ssd1309_draw_string(fb, 0, 0, "CAN %d IDS %d BAD", n, bad);
+    ssd1309_draw_line(fb, 0, 10, 128, 10, 1);
+
+    int pages = (n + CAN_PAGE_ROWS - 1) / CAN_PAGE_ROWS;
+    int first = pages > 1 ? (int)(shown_us / 1000 / CAN_PAGE_MS % pages) * CAN_PAGE_ROWS : 0;
+    for (int i = first; i < n && i < first + CAN_PAGE_ROWS; i++) {
+        const can_id_stat_t *e = &ids[i];
+        can_id_status_t st = can_id_check(e, now_us);
+        int y = 13 + (i - first) * 10;
+        if (st == CAN_ID_MISSING) {
+            if (e->count) ssd1309_draw_string(fb, 0, y, "%3lX MISS %.1fs ago", e->id & ~CAN_ID_EXTD,
+                                              (now_us - e->last_us) / 1e6);
+            else ssd1309_draw_string(fb, 0, y, "%3lX MISS never", e->id & ~CAN_ID_EXTD);
+        } else {
+            ssd1309_draw_string(fb, 0, y, "%3lX %-4s %4lums j%lu", e->id & ~CAN_ID_EXTD, status_names[st],
+                                e->avg_us / 1000, e->jitter_us / 1000);
         }
     }
-
-
-
-    // Timing
-    draw_race_timer(fb, 80, 56);
+    return pages > 0 ? pages : 1;
 }
 
-// Heavy data mode
-void draw_engineer(uint8_t *fb, car_state_t *car) {
+// TWAI controller health: error counters, queue depth, frames lost
+void draw_can_bus(uint8_t *fb) {
+    static const char *states[] = { "STOPPED", "RUNNING", "BUS OFF", "RECOVER" };
+    can_health_t h;
+    can_get_health(&h);
+
     ssd1309_clear_buffer(fb);
-    ssd1309_draw_string(fb, 0, 0, "SYSTEM: ONLINE");
+    ssd1309_draw_string(fb, 0, 0, "BUS %s OFF %lu", h.state < 4 ? states[h.state] : "?", h.bus_off);
     ssd1309_draw_line(fb, 0, 10, 128, 10, 1);
-    
-    ssd1309_draw_string(fb, 0,  15, "RPM:%d", car->rpm);
-    ssd1309_draw_string(fb, 65, 15, "SPD:%dkm/h", car->speed);
-    ssd1309_draw_string(fb, 0,  28, "ENG:%d C", car->eng_temp);
-    ssd1309_draw_string(fb, 65, 28, "CVT:%d C", car->cvt_temp);
-    ssd1309_draw_string(fb, 0,  41, "BAT:%.1fV", car->voltage);
-    ssd1309_draw_string(fb, 65, 41, "FUEL:%d%%", car->fuel);
-    ssd1309_draw_string(fb, 0, 54, "R:%d P:%d", car->roll, car->pitch);
+    ssd1309_draw_string(fb, 0, 13, "TEC %lu/%lu REC %lu/%lu", h.tx_err, h.tx_err_max, h.rx_err, h.rx_err_max);
+    ssd1309_draw_string(fb, 0, 24, "RXQ %lu HW %lu/%d TXQ %lu", h.rx_queued, h.rx_queued_max, CAN_RX_QUEUE_LEN,
+                        h.tx_queued_max);
+    ssd1309_draw_string(fb, 0, 35, "MISS %lu OVR %lu", h.rx_missed, h.rx_overrun);
+    ssd1309_draw_string(fb, 0, 46, "ARB %lu ERR %lu TXF %lu", h.arb_lost, h.bus_error, h.tx_failed);
+
+    // What the wheel itself sends
+    can_tx_stats_t tx;
+    can_tx_get_stats(&tx);
+    ssd1309_draw_string(fb, 0, 56, "TX %lu/s MAX %lu REF %lu", tx.rate, tx.rate_max, tx.refused);
 }
 
-// Adventure mode, add more data here
-void draw_adventure(uint8_t *fb, car_state_t *car) {
-    ssd1309_clear_buffer(fb);
-    int cx = 64, cy = 32;
-    // Scale: 100 = 10.0 degrees
-    float roll_rad = (car->roll / 10.0f) * (3.14159f / 180.0f); 
-    int pitch_offset = (car->pitch / 10.0f); 
-    
-    // Calculate Horizon Line
-    float cos_a = cos(roll_rad);
-    float sin_a = sin(roll_rad);
-    int len = 80; 
-    int x0 = cx - (int)(len * cos_a);
-    int y0 = (cy + pitch_offset) + (int)(len * sin_a);
-    int x1 = cx + (int)(len * cos_a);
-    int y1 = (cy + pitch_offset) - (int)(len * sin_a);
-    
-    ssd1309_draw_line(fb, x0, y0, x1, y1, 1);
-    ssd1309_draw_line(fb, 60, 0, 68, 0, 1); // Sky Ref
-    ssd1309_draw_line(fb, 44, 32, 84, 32, 1); // Wings
-    
-    ssd1309_draw_string(fb, 0, 56, "P:%d", car->pitch/10);
-    ssd1309_draw_string(fb, 90, 56, "R:%d", car->roll/10);
+// Engineer mode: car data, then the per ID table, then the bus health
+void draw_engineer_pages(uint8_t *fb, const car_state_t *car, int64_t now_us) {
+    static eng_page_t page = ENG_PAGE_DATA;
+    static int64_t page_start_us = 0;
+    static int can_pages = 1;
+
+    int64_t shown_us = now_us - page_start_us;
+    int64_t dwell_ms = (page == ENG_PAGE_CAN_IDS) ? (int64_t)can_pages * CAN_PAGE_MS : ENG_PAGE_MS;
+    if (shown_us >= dwell_ms * 1000) {
+        page = (page + 1) % ENG_PAGE_COUNT;
+        page_start_us = now_us;
+        shown_us = 0;
+    }
+    switch (page) {
+        case ENG_PAGE_DATA:    draw_engineer(fb, car); break;
+        case ENG_PAGE_CAN_IDS: can_pages = draw_can_ids(fb, now_us, shown_us); break;
+        case ENG_PAGE_CAN_BUS: draw_can_bus(fb); break;
+        case ENG_PAGE_COUNT:   break;
+    }
 }
 
-// My mode, saab inspired
-// Still needs much tweaking
-void draw_night_mode(uint8_t *fb, car_state_t *car) {
-    ssd1309_clear_buffer(fb);
-    bool show_fuel = (car->fuel < 20);
-    bool show_bat = (car->voltage < 11.8);
-    bool show_cvt = (car->cvt_temp > 90);
-    bool show_eng = (car->eng_temp > 90);
-
-    // Speedometer (Centered Left)
-    draw_dynamic_gauge(fb, 32, 32, 28, car->speed, 55.0f, "KPH", 0.65f);
-
-    // Tachometer (Centered Right - Ghost)
-    if (car->rpm > 3400) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            draw_dynamic_gauge(fb, 96, 32, 28, car->rpm, 3800.0f, "RPM", 0.65f);
-        }
-    } else{
-        draw_dynamic_gauge(fb, 96, 32, 28, car->rpm, 3800.0f, "RPM", 0.65f);
+// Runs in the CAN task: abort the frame being flushed and wake the loop
+static void on_box_alert(const car_state_t *state) {
+    static int64_t logged_alert_us = -1;
+    if (!state->box_alert) return;
+    // Repeats of the same call would keep stretching the capture
+    if (state->box_alert_time_us != logged_alert_us) {
+        logged_alert_us = state->box_alert_time_us;
+        sd_log_event(SD_EVENT_BOX);
     }
+    ssd1309_request_preempt();
+    if (main_task) xTaskNotifyGive(main_task);
+}
 
-    // Low Fuel Warning
-    if (show_fuel) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 30, 56, "F");
-            // ssd1309_draw_bitmap(fb, 30, 56, icon_fuel, 16, 16, 1); // I don't know how to draw.
-        }
-    }
+// --- BOOT ---
+// Display, CAN and SD share nothing until the main loop, so each comes up
+// in its own lane: the panel reset and the card mount wait on their buses
+// side by side instead of one after the other. The SD lane only opens its
+// files once CAN is up, their first health snapshot needs a running driver.
+// sys_clock times, the log line has how long each lane took
+static struct {
+    SemaphoreHandle_t display_done;
+    SemaphoreHandle_t can_up;
+    SemaphoreHandle_t sd_done;
+    int64_t display_us;     // Reset and init over, panel on
+    int64_t splash_us;      // First frame on the panel
+    int64_t can_us;
+    int64_t nvs_us;
+    int64_t sd_start_us;    // CAN was up, mount starts
+    int64_t sd_us;          // Mount and recovery over, logging or not
+    bool sd_ok;
+} boot;
+
+static void boot_display_task(void *arg)
+{
+    i2c_master_bus_handle_t bus_handle;
 
-    // Low Fuel Warning
-    if (show_bat) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 20, 56, "B");
-        }
-    }
+    // Initialize using new driver [cite: 88, 120, 134]
+    ESP_ERROR_CHECK(ssd1309_hw_init(&bus_handle, &screen_handle));
+    ssd1309_init(screen_handle);
+    boot.display_us = sys_clock_us();
 
-    // Low Fuel Warning
-    if (show_cvt) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 10, 56, "T");
-        }
-    }
+    // Splash goes out once, it stays up until the pilot does something
+    ssd1309_draw_string_large(s_buffer, 10, 20, 2, "MANGUE");
+    ssd1309_draw_string_large(s_buffer, 55, 40, 2, "BAJA");
+    ssd1309_display_buffer(screen_handle, s_buffer);
+    boot.splash_us = sys_clock_us();
 
-    if (show_eng) {
-        if (xTaskGetTickCount() % 20 < 10) {
-            ssd1309_draw_string(fb, 0, 56, "E");
-        }
+    xSemaphoreGive(boot.display_done);
+    vTaskDelete(NULL);
+}
+
+static void boot_sd_task(void *arg)
+{
+    // NVS keeps the SD session counter between boots
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
     }
+    ESP_ERROR_CHECK(err);
+    boot.nvs_us = sys_clock_us();
+
+    // can_N.bin opens with a health snapshot, that needs the driver started
+    xSemaphoreTake(boot.can_up, portMAX_DELAY);
+    boot.sd_start_us = sys_clock_us();
+
+    // Dashboard runs fine without a card, logging just stays off
+    boot.sd_ok = sd_logging_init() == ESP_OK;
+    boot.sd_us = sys_clock_us();
 
-    draw_race_timer(fb, 80, 56);
+    xSemaphoreGive(boot.sd_done);
+    vTaskDelete(NULL);
 }
 
 // Main function, no FreeRTOS needed here
 void app_main(void)
 {
-    i2c_master_bus_handle_t bus_handle;
-    i2c_master_dev_handle_t screen_handle;
+    main_task = xTaskGetCurrentTaskHandle();
+    int64_t boot_start_us = sys_clock_us();
+
+    boot.display_done = xSemaphoreCreateBinary();
+    boot.can_up = xSemaphoreCreateBinary();
+    boot.sd_done = xSemaphoreCreateBinary();
+    if (!boot.display_done || !boot.can_up || !boot.sd_done ||
+        xTaskCreate(boot_display_task, "boot_disp", BOOT_TASK_STACK, NULL, BOOT_TASK_PRIORITY, NULL) != pdPASS ||
+        xTaskCreate(boot_sd_task, "boot_sd", BOOT_TASK_STACK, NULL, BOOT_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start boot tasks");
+        ESP_ERROR_CHECK(ESP_ERR_NO_MEM);
+    }
 
-    // Initialize using new driver [cite: 88, 120, 134]
-    ESP_ERROR_CHECK(ssd1309_hw_init(&bus_handle, &screen_handle));
-    ssd1309_init(screen_handle);
+    // CAN is this task's lane, the bus is live while the others still wait
+    can_set_box_alert_callback(on_box_alert);
     can_init(); // Pin 5 (TX) - Pin 18 (RX)
+    xSemaphoreGive(boot.can_up);
+    // Gestures are queued for us and wake the loop like a BOX alert does
+    ESP_ERROR_CHECK(button_init(PIN_BUTTON, main_task));
+    boot.can_us = sys_clock_us();
+
+    xSemaphoreTake(boot.display_done, portMAX_DELAY);
+    xSemaphoreTake(boot.sd_done, portMAX_DELAY);
+    vSemaphoreDelete(boot.display_done);
+    vSemaphoreDelete(boot.can_up);
+    vSemaphoreDelete(boot.sd_done);
+    ESP_LOGI(TAG, "Boot: splash at %lld ms (panel init %lld ms), CAN %lld ms, NVS %lld ms, SD %lld ms, ready at %lld ms",
+             boot.splash_us / 1000, (boot.display_us - boot_start_us) / 1000, (boot.can_us - boot_start_us) / 1000,
+             (boot.nvs_us - boot_start_us) / 1000, (boot.sd_us - boot.sd_start_us) / 1000, sys_clock_ms());
+
+    bool sd_ok = boot.sd_ok;
+    if (!sd_ok) {
+        ESP_LOGW(TAG, "SD logging disabled");
+    } else if (can_replay_from_card() == ESP_OK) {
+        // Bench: a capture on the card plays back as if the car sent it
+        ESP_LOGI(TAG, "CAN replay running");
+    } else if (can_stress_from_card() == ESP_OK) {
+        // Bench: steps up the bus load until frames get lost
+        ESP_LOGI(TAG, "CAN stress test running");
+    }
 
-    gpio_set_direction(PIN_BUTTON, GPIO_MODE_INPUT);
-    gpio_set_pull_mode(PIN_BUTTON, GPIO_PULLUP_ONLY);
+    uint8_t status_flags = sd_ok ? CAN_STATUS_SD_LOGGING : 0;
+    can_tx_set_status(current_mode, status_flags);
 
     car_state_t car = {0};
     int64_t last_pkt_time = 0;
-    int64_t last_btn_time = 0;
+    int64_t link_up_time = 0;
+    alert_mask_t last_alerts = 0;
+    uint32_t last_bus_off = 0;
+    int64_t last_box_alert_us = 0;
+    int64_t box_latency_max_us = 0;
 
     ESP_LOGI(TAG, "Dashboard Initialized.");
 
-    while (gpio_get_level(PIN_BUTTON) !=0) {
-        ssd1309_draw_string_large(s_buffer, 10, 20, 2, "MANGUE");
-        ssd1309_draw_string_large(s_buffer, 55, 40, 2, "BAJA");
-        ssd1309_display_buffer(screen_handle, s_buffer);
+    // The splash is up, sleep until the pilot does something
+    button_event_t ev;
+    while (!button_get_event(&ev)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
 
-    race_start_time = esp_timer_get_time();
+    race_start_time = sys_clock_us();
 
     while(1) {
-        int64_t now = esp_timer_get_time() / 1000;
+        int64_t now = sys_clock_ms();
 
         // Updates data if available
         if (can_update_state(&car)) {
             last_pkt_time = now;
+            if (!car.link_active) link_up_time = now;
             car.link_active = true;
+
+            // Raw values, before filtering. Never blocks, the logger task writes
+            sd_log_data(&car, (uint32_t)now);
             
-            // Apply Low-Pass Filter (EMA) to smooth needles
-            signal_filter.rpm = (FILTER_ALPHA * car.rpm) + ((1.0 - FILTER_ALPHA) * signal_filter.rpm);
-            signal_filter.fuel = (FILTER_ALPHA * car.fuel) + ((1.0 - FILTER_ALPHA) * signal_filter.fuel);
-            
-            // Write smoothed values back for display
-            car.rpm = (uint16_t)signal_filter.rpm;
-            car.fuel = (uint16_t)signal_filter.fuel;
+            // Smoothed needles from here on
+            dash_filter_apply(&signal_filter, &car);
+
+            // Re-evaluates the alert table only when inputs moved
+            alert_engine_update(&car);
+
+            // A newly raised alert is worth the full-rate CAN around it. Not
+            // right after link-up: the filters start from 0 and the slow
+            // signals are not in yet, so low fuel and the like rise falsely
+            alert_mask_t alerts = alert_engine_active();
+            bool settled = now - link_up_time >= TIMEOUT_MS;
+            if (settled && (alerts & ~last_alerts)) sd_log_event(SD_EVENT_ALERT);
+            last_alerts = alerts;
+        }
+
+        if (can_bus_off_count() != last_bus_off) {
+            last_bus_off = can_bus_off_count();
+            sd_log_event(SD_EVENT_BUS_OFF);
         }
 
         // Dead link warning
@@ -316,44 +341,75 @@ void app_main(void)
             car.link_active = false;
             car.rpm = 0; car.speed = 0; // Kill gauges
         }
-        // Check for button input
-        if (gpio_get_level(PIN_BUTTON) == 0) {
-            if (now - last_btn_time > 300) { 
-                current_mode++;
-                if (current_mode >= MODE_COUNT) current_mode = 0;
-                last_btn_time = now;
+        // Tell the car, only changes cost anything
+        can_tx_emergency(CAN_EMERG_NO_LINK, !car.link_active);
+        // Button gestures: a press cycles the mode, holding it marks an
+        // event for the engineers, a double press calls the pilot in
+        while (button_get_event(&ev)) {
+            switch (ev.gesture) {
+                case BUTTON_SHORT:
+                    current_mode++;
+                    if (current_mode >= MODE_COUNT) current_mode = 0;
+                    break;
+                case BUTTON_LONG:
+                    sd_log_event(SD_EVENT_MANUAL);
+                    break;
+                case BUTTON_DOUBLE:
+                    can_tx_request(CAN_REQ_BOX);
+                    ESP_LOGI(TAG, "Pilot asked to box");
+                    break;
             }
         }
 
+        // Heartbeat content, the TX task sends it on its own clock
+        can_tx_set_status(current_mode, status_flags | (car.link_active ? CAN_STATUS_LINK : 0));
 
         // Render screen
+        dash_ctx_t ctx = {
+            .now_us = sys_clock_us(),
+            .race_start_us = race_start_time,
+            .alerts = alert_engine_active(),
+        };
+        bool fresh_alert = false;
         if (!car.link_active) {
-            ssd1309_clear_buffer(s_buffer);
-            ssd1309_draw_rect(s_buffer, 0, 0, 128, 64, 1, 0); // Warning border
-            ssd1309_draw_string_large(s_buffer, 15, 20, 2, "NO LINK");
-            ssd1309_draw_string(s_buffer, 35, 45, "CHECK ECU");
+            draw_no_link(s_buffer);
         } else if (car.box_alert) {
-            if (xTaskGetTickCount() % 20 < 10) {
+            // A new alert is always shown at once, then it blinks
+            fresh_alert = (car.box_alert_time_us != last_box_alert_us);
+            if (fresh_alert || dash_blink_phase(&ctx)) {
+                draw_box_alert(s_buffer, &car);
+            } else {
                 ssd1309_clear_buffer(s_buffer);
-                ssd1309_draw_rect(s_buffer, 0, 0, 128, 64, 1, 0); // Warning border
-                ssd1309_draw_string_large(s_buffer, 15, 20, 2, "BOX BOX!");
-                switch (car.box_alert_message) {
-                    case CVT: ssd1309_draw_string(s_buffer, 35, 45, "CVT ISSUE"); break;
-                    case FUEL: ssd1309_draw_string(s_buffer, 35, 45, "REFUEL"); break;
-                    case BAT: ssd1309_draw_string(s_buffer, 35, 45, "BAT SWITCH"); break;
-                }
             }
         } else {
             switch(current_mode) {
-                case MODE_PILOT:     draw_pilot(s_buffer, &car); break;
-                case MODE_ENGINEER:  draw_engineer(s_buffer, &car); break;
+                case MODE_PILOT:     draw_pilot(s_buffer, &car, &ctx); break;
+                case MODE_ENGINEER:  draw_engineer_pages(s_buffer, &car, ctx.now_us); break;
+                case MODE_LOGGER:    draw_logger(s_buffer); break;
                 case MODE_ADVENTURE: draw_adventure(s_buffer, &car); break;
-                case MODE_NIGHT:     draw_night_mode(s_buffer, &car); break;
+                case MODE_NIGHT:     draw_night_mode(s_buffer, &car, &ctx); break;
                 case MODE_COUNT: break;
             }
         }
 
-        ssd1309_display_buffer(screen_handle, s_buffer);
-        vTaskDelay(pdMS_TO_TICKS(30)); // 100 FPS target (system permitting)
+        if (car.box_alert && car.link_active) {
+            // Minimal partial update, only what changed goes over I2C
+            ssd1309_display_dirty(screen_handle, s_buffer);
+        } else {
+            // Aborted early if a BOX alert comes in mid-flush
+            ssd1309_display_buffer(screen_handle, s_buffer);
+        }
+
+        // Alert-to-photon latency, from frame decode to last byte on the panel
+        if (fresh_alert) {
+            int64_t latency_us = sys_clock_us() - car.box_alert_time_us;
+            if (latency_us > box_latency_max_us) box_latency_max_us = latency_us;
+            ESP_LOGI(TAG, "BOX alert on screen in %lld us (max %lld us)", latency_us, box_latency_max_us);
+            can_tx_request(CAN_REQ_ALERT_SEEN);
+            last_box_alert_us = car.box_alert_time_us;
+        }
+
+        // Sleeps like vTaskDelay but a BOX alert wakes us up right away
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(30)); // 100 FPS target (system permitting)
     }
 }
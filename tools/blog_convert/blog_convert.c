@@ -0,0 +1,163 @@
+// Converts binary steering wheel logs (log_N.bin) to text
+//   blog_convert [-f csv|tsv|jsonl] [-o out.csv] log_N.bin
+// Corrupt blocks (bad sync or CRC) are skipped and counted on stderr.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_format.h"
+
+typedef enum { OUT_CSV, OUT_TSV, OUT_JSONL } out_format_t;
+
+typedef struct {
+    blog_file_header_t hdr;
+    blog_signal_t sig[BLOG_MAX_SIGNALS];
+} log_info_t;
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: blog_convert [-f csv|tsv|jsonl] [-o output] log_N.bin\n");
+    exit(2);
+}
+
+static int read_header(FILE *in, log_info_t *info, uint8_t *block)
+{
+    if (fread(block, 1, BLOG_BLOCK_SIZE, in) != BLOG_BLOCK_SIZE) return -1;
+    memcpy(&info->hdr, block, sizeof(info->hdr));
+
+    if (memcmp(info->hdr.magic, BLOG_MAGIC, sizeof(info->hdr.magic)) != 0) {
+        fprintf(stderr, "not a steering wheel log (bad magic)\n");
+        return -1;
+    }
+    if (info->hdr.version < BLOG_VERSION_MIN || info->hdr.version > BLOG_VERSION) {
+        fprintf(stderr, "log version %u, this tool reads versions %u to %u\n",
+                info->hdr.version, BLOG_VERSION_MIN, BLOG_VERSION);
+        return -1;
+    }
+    if (info->hdr.block_size != BLOG_BLOCK_SIZE || info->hdr.signal_count > BLOG_MAX_SIGNALS) {
+        fprintf(stderr, "unsupported block size or signal count\n");
+        return -1;
+    }
+    memcpy(info->sig, block + sizeof(info->hdr), info->hdr.signal_count * sizeof(blog_signal_t));
+    if (!blog_signals_valid(&info->hdr, info->sig)) {
+        fprintf(stderr, "damaged header (signal types or record size)\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Prints a fixed point value, e.g. 1234 with exp10 = -2 as 12.34
+static void print_value(FILE *out, int32_t v, int8_t exp10)
+{
+    if (exp10 >= 0) {
+        int64_t scaled = v;
+        for (int8_t e = 0; e < exp10; e++) scaled *= 10;
+        fprintf(out, "%lld", (long long)scaled);
+        return;
+    }
+    int64_t div = 1;
+    for (int8_t e = exp10; e < 0; e++) div *= 10;
+    int64_t mag = v < 0 ? -(int64_t)v : v;
+    fprintf(out, "%s%lld.%0*lld", v < 0 ? "-" : "", (long long)(mag / div), -exp10, (long long)(mag % div));
+}
+
+static void print_header(FILE *out, const log_info_t *info, out_format_t fmt)
+{
+    if (fmt == OUT_JSONL) return;
+    char sep = (fmt == OUT_TSV) ? '\t' : ',';
+    fprintf(out, "Time_ms");
+    for (int i = 0; i < info->hdr.signal_count; i++) {
+        fprintf(out, "%c%.*s", sep, BLOG_NAME_LEN, info->sig[i].name);
+    }
+    fputc('\n', out);
+}
+
+static void print_record(FILE *out, const log_info_t *info, out_format_t fmt, uint32_t t_ms, const int32_t *vals)
+{
+    if (fmt == OUT_JSONL) {
+        fprintf(out, "{\"Time_ms\":%u", t_ms);
+        for (int i = 0; i < info->hdr.signal_count; i++) {
+            fprintf(out, ",\"%.*s\":", BLOG_NAME_LEN, info->sig[i].name);
+            print_value(out, vals[i], info->sig[i].exp10);
+        }
+        fputs("}\n", out);
+        return;
+    }
+    char sep = (fmt == OUT_TSV) ? '\t' : ',';
+    fprintf(out, "%u", t_ms);
+    for (int i = 0; i < info->hdr.signal_count; i++) {
+        fputc(sep, out);
+        print_value(out, vals[i], info->sig[i].exp10);
+    }
+    fputc('\n', out);
+}
+
+typedef struct {
+    FILE *out;
+    const log_info_t *info;
+    out_format_t fmt;
+} print_ctx_t;
+
+static void on_record(void *ctx, uint32_t t_ms, const int32_t *vals)
+{
+    print_ctx_t *pc = ctx;
+    print_record(pc->out, pc->info, pc->fmt, t_ms, vals);
+}
+
+int main(int argc, char **argv)
+{
+    out_format_t fmt = OUT_CSV;
+    const char *out_path = NULL;
+    const char *in_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "csv") == 0) fmt = OUT_CSV;
+            else if (strcmp(f, "tsv") == 0) fmt = OUT_TSV;
+            else if (strcmp(f, "jsonl") == 0) fmt = OUT_JSONL;
+            else usage();
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] == '-' || in_path) {
+            usage();
+        } else {
+            in_path = argv[i];
+        }
+    }
+    if (!in_path) usage();
+
+    FILE *in = fopen(in_path, "rb");
+    if (!in) { perror(in_path); return 1; }
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { perror(out_path); return 1; }
+
+    uint8_t block[BLOG_BLOCK_SIZE];
+    log_info_t info;
+    if (read_header(in, &info, block) != 0) return 1;
+    print_header(out, &info, fmt);
+
+    size_t blocks = 0, bad_blocks = 0, records = 0;
+    print_ctx_t pc = { out, &info, fmt };
+
+    while (fread(block, 1, BLOG_BLOCK_SIZE, in) == BLOG_BLOCK_SIZE) {
+        // Torn, or left over from an older file on the same clusters
+        if (!blog_block_in_sequence(block, info.hdr.session, blocks++)) {
+            bad_blocks++;
+            continue;
+        }
+
+        int n = blog_decode_block(&info.hdr, info.sig, block, on_record, &pc);
+        if (n < 0) {
+            bad_blocks++;
+            continue;
+        }
+        records += n;
+    }
+
+    fprintf(stderr, "%s: session %u, %zu records in %zu blocks, %zu bad blocks skipped\n",
+            in_path, info.hdr.session, records, blocks, bad_blocks);
+
+    fclose(in);
+    if (out != stdout) fclose(out);
+    return bad_blocks ? 3 : 0;
+}
@@ -0,0 +1,521 @@
+#define _DEFAULT_SOURCE
+#include "blog_reader.h"
+#include "log_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_COLS            BLOG_MAX_SIGNALS
+// Delta records are at least a dt byte and a one byte bitmap
+#define MAX_BLOCK_RECORDS   ((int)(BLOG_BLOCK_PAYLOAD / 2))
+#define INDEX_MAGIC         "BLOGIDX"
+
+typedef struct {
+    uint32_t t_ms;
+    uint32_t reserved;
+    uint64_t offset;        // Block start (binary) or line start (CSV)
+} index_entry_t;
+
+// <log>.idx: this header, then count entries. Only trusted if the log
+// still has the size and mtime it was built from
+typedef struct {
+    char magic[8];
+    uint64_t file_size;
+    int64_t mtime;
+    uint32_t stride;
+    uint32_t count;
+} index_header_t;
+
+struct blog_reader {
+    char *path;
+    int fd;
+    const uint8_t *map;
+    size_t size;
+    int64_t mtime;
+    bool binary;
+    int ncols;
+    char names[MAX_COLS][BLOG_NAME_LEN + 1];
+    size_t data_start;      // First block / first data line
+
+    // Binary only
+    blog_file_header_t hdr;
+    blog_signal_t sig[MAX_COLS];
+    uint32_t blk_t[MAX_BLOCK_RECORDS];
+    int32_t blk_vals[MAX_BLOCK_RECORDS][MAX_COLS];
+    int blk_count;
+    int blk_next;
+
+    index_entry_t *index;
+    size_t index_count;
+    bool index_ready;
+
+    // Cursor: pos is the next block / line to read. hold makes the next
+    // blog_reader_next() return the current record again (after a seek)
+    size_t pos;
+    bool hold;
+    bool valid;
+    uint32_t t_ms;
+    const int32_t *vals;
+    const char *field[MAX_COLS + 1];    // [0] is the time
+    size_t field_len[MAX_COLS + 1];
+    size_t bad;
+};
+
+static const double pow10_table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+static double scale(int32_t v, int8_t exp10)
+{
+    if (exp10 >= 0) return v * pow10_table[exp10 > 9 ? 9 : exp10];
+    return v / pow10_table[-exp10 > 9 ? 9 : -exp10];
+}
+
+// --- CSV ---
+
+// Splits one line (no newline) into fields, returns how many
+static int split_csv(const char *line, size_t len, const char **field, size_t *field_len, int max)
+{
+    int n = 0;
+    const char *p = line, *end = line + len;
+    while (n < max) {
+        const char *comma = memchr(p, ',', end - p);
+        const char *stop = comma ? comma : end;
+        field[n] = p;
+        field_len[n] = stop - p;
+        n++;
+        if (!comma) return n;
+        p = comma + 1;
+    }
+    return n + 1; // More fields than wanted
+}
+
+// Line at off: start and length without the line break, returns the offset
+// of the line after it
+static size_t csv_line(const blog_reader_t *r, size_t off, const char **line, size_t *len)
+{
+    const char *start = (const char *)r->map + off;
+    const char *nl = memchr(start, '\n', r->size - off);
+    size_t n = nl ? (size_t)(nl - start) : r->size - off;
+    *line = start;
+    *len = (n > 0 && start[n - 1] == '\r') ? n - 1 : n;
+    return off + n + (nl ? 1 : 0);
+}
+
+static bool parse_u32(const char *s, size_t len, uint32_t *out)
+{
+    if (len == 0 || len > 10) return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    if (v > UINT32_MAX) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static bool csv_next(blog_reader_t *r)
+{
+    while (r->pos < r->size) {
+        const char *line;
+        size_t len;
+        r->pos = csv_line(r, r->pos, &line, &len);
+        if (len == 0) continue;
+
+        int n = split_csv(line, len, r->field, r->field_len, r->ncols + 1);
+        if (n != r->ncols + 1 || !parse_u32(r->field[0], r->field_len[0], &r->t_ms)) {
+            // A header again (appended session) is not an error
+            if (len < 7 || memcmp(line, "Time_ms", 7) != 0) r->bad++;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool csv_open(blog_reader_t *r, char *err, size_t err_size)
+{
+    const char *line;
+    size_t len;
+    r->data_start = csv_line(r, 0, &line, &len);
+
+    const char *field[MAX_COLS + 2];
+    size_t field_len[MAX_COLS + 2];
+    int n = split_csv(line, len, field, field_len, MAX_COLS + 1);
+    if (n < 2 || n > MAX_COLS + 1 || field_len[0] != 7 || memcmp(field[0], "Time_ms", 7) != 0) {
+        snprintf(err, err_size, "not a log: no Time_ms header or too many columns");
+        return false;
+    }
+    r->ncols = n - 1;
+    for (int i = 0; i < r->ncols; i++) {
+        size_t l = field_len[i + 1] > BLOG_NAME_LEN ? BLOG_NAME_LEN : field_len[i + 1];
+        memcpy(r->names[i], field[i + 1], l);
+        r->names[i][l] = '\0';
+    }
+    return true;
+}
+
+// --- Binary ---
+
+static void on_record(void *ctx, uint32_t t_ms, const int32_t *vals)
+{
+    blog_reader_t *r = ctx;
+    if (r->blk_count >= MAX_BLOCK_RECORDS) return;
+    r->blk_t[r->blk_count] = t_ms;
+    memcpy(r->blk_vals[r->blk_count], vals, r->ncols * sizeof(int32_t));
+    r->blk_count++;
+}
+
+static bool block_ok(const blog_reader_t *r, size_t off)
+{
+    uint32_t seq = (uint32_t)((off - r->data_start) / BLOG_BLOCK_SIZE);
+    return blog_block_in_sequence(r->map + off, r->hdr.session, seq);
+}
+
+static bool bin_next(blog_reader_t *r)
+{
+    while (r->blk_next >= r->blk_count) {
+        if (r->pos + BLOG_BLOCK_SIZE > r->size) return false;
+        size_t off = r->pos;
+        r->pos += BLOG_BLOCK_SIZE;
+        r->blk_count = r->blk_next = 0;
+        // Torn, stale or preallocated junk
+        if (!block_ok(r, off) || blog_decode_block(&r->hdr, r->sig, r->map + off, on_record, r) < 0) {
+            r->blk_count = 0;
+            r->bad++;
+        }
+    }
+    r->t_ms = r->blk_t[r->blk_next];
+    r->vals = r->blk_vals[r->blk_next];
+    r->blk_next++;
+    return true;
+}
+
+static bool bin_open(blog_reader_t *r, char *err, size_t err_size)
+{
+    if (r->size < BLOG_BLOCK_SIZE) {
+        snprintf(err, err_size, "too short");
+        return false;
+    }
+    memcpy(&r->hdr, r->map, sizeof(r->hdr));
+    if (r->hdr.version < BLOG_VERSION_MIN || r->hdr.version > BLOG_VERSION) {
+        snprintf(err, err_size, "log version %u, this reader handles %u to %u",
+                 r->hdr.version, BLOG_VERSION_MIN, BLOG_VERSION);
+        return false;
+    }
+    if (r->hdr.block_size != BLOG_BLOCK_SIZE || r->hdr.signal_count > MAX_COLS) {
+        snprintf(err, err_size, "unsupported block size or signal count");
+        return false;
+    }
+    memcpy(r->sig, r->map + sizeof(r->hdr), r->hdr.signal_count * sizeof(blog_signal_t));
+    if (!blog_signals_valid(&r->hdr, r->sig)) {
+        snprintf(err, err_size, "damaged header (signal types or record size)");
+        return false;
+    }
+    r->ncols = r->hdr.signal_count;
+    for (int i = 0; i < r->ncols; i++) {
+        memcpy(r->names[i], r->sig[i].name, BLOG_NAME_LEN);
+        r->names[i][BLOG_NAME_LEN] = '\0';
+    }
+    r->data_start = BLOG_BLOCK_SIZE;
+    return true;
+}
+
+// --- Index ---
+
+static bool index_add(blog_reader_t *r, size_t *cap, uint32_t t_ms, size_t offset)
+{
+    if (r->index_count == *cap) {
+        size_t n = *cap ? *cap * 2 : 256;
+        index_entry_t *grown = realloc(r->index, n * sizeof(*grown));
+        if (!grown) return false;
+        r->index = grown;
+        *cap = n;
+    }
+    r->index[r->index_count++] = (index_entry_t){ .t_ms = t_ms, .offset = offset };
+    return true;
+}
+
+// Jumps BLOG_INDEX_STRIDE at a time and takes the first record found there,
+// only the pages at those points get touched
+static void build_index(blog_reader_t *r)
+{
+    size_t cap = 0;
+    for (size_t target = r->data_start; target < r->size; target += BLOG_INDEX_STRIDE) {
+        size_t limit = target + BLOG_INDEX_STRIDE;
+        if (r->binary) {
+            for (size_t off = target; off + BLOG_BLOCK_SIZE <= r->size && off < limit; off += BLOG_BLOCK_SIZE) {
+                if (!block_ok(r, off)) continue;
+                blog_block_header_t bh;
+                memcpy(&bh, r->map + off, sizeof(bh));
+                if (bh.record_count == 0) continue;
+                // First record: base time plus its dt byte
+                index_add(r, &cap, bh.base_ms + r->map[off + sizeof(bh)], off);
+                break;
+            }
+        } else {
+            // Start of the first full line at or after target
+            size_t off = target;
+            if (off > r->data_start) {
+                const char *nl = memchr(r->map + off - 1, '\n', r->size - off + 1);
+                if (!nl) break;
+                off = (const uint8_t *)nl + 1 - r->map;
+            }
+            while (off < r->size && off < limit) {
+                const char *line;
+                size_t len;
+                size_t next = csv_line(r, off, &line, &len);
+                const char *comma = memchr(line, ',', len);
+                uint32_t t;
+                if (comma && parse_u32(line, comma - line, &t)) {
+                    index_add(r, &cap, t, off);
+                    break;
+                }
+                off = next;
+            }
+        }
+    }
+}
+
+static char *index_path(const blog_reader_t *r)
+{
+    size_t n = strlen(r->path) + 5;
+    char *p = malloc(n);
+    if (p) snprintf(p, n, "%s.idx", r->path);
+    return p;
+}
+
+static bool load_index(blog_reader_t *r)
+{
+    char *path = index_path(r);
+    FILE *f = path ? fopen(path, "rb") : NULL;
+    free(path);
+    if (!f) return false;
+
+    index_header_t ih;
+    bool ok = fread(&ih, sizeof(ih), 1, f) == 1 &&
+              memcmp(ih.magic, INDEX_MAGIC, sizeof(ih.magic)) == 0 &&
+              ih.file_size == r->size && ih.mtime == r->mtime && ih.stride == BLOG_INDEX_STRIDE;
+    if (ok) {
+        r->index = malloc((ih.count ? ih.count : 1) * sizeof(index_entry_t));
+        ok = r->index && fread(r->index, sizeof(index_entry_t), ih.count, f) == ih.count;
+        r->index_count = ok ? ih.count : 0;
+    }
+    fclose(f);
+    return ok;
+}
+
+static void ensure_index(blog_reader_t *r)
+{
+    if (r->index_ready) return;
+    if (!load_index(r)) {
+        free(r->index);
+        r->index = NULL;
+        r->index_count = 0;
+        build_index(r);
+    }
+    r->index_ready = true;
+}
+
+bool blog_reader_save_index(blog_reader_t *r)
+{
+    ensure_index(r);
+    char *path = index_path(r);
+    FILE *f = path ? fopen(path, "wb") : NULL;
+    free(path);
+    if (!f) return false;
+
+    index_header_t ih = {
+        .magic = INDEX_MAGIC,
+        .file_size = r->size,
+        .mtime = r->mtime,
+        .stride = BLOG_INDEX_STRIDE,
+        .count = (uint32_t)r->index_count,
+    };
+    bool ok = fwrite(&ih, sizeof(ih), 1, f) == 1 &&
+              fwrite(r->index, sizeof(index_entry_t), r->index_count, f) == r->index_count;
+    return (fclose(f) == 0) && ok;
+}
+
+// --- Public ---
+
+blog_reader_t *blog_reader_open(const char *path, char *err, size_t err_size)
+{
+    blog_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        snprintf(err, err_size, "out of memory");
+        return NULL;
+    }
+    r->fd = -1;
+    r->path = strdup(path);
+
+    struct stat st;
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0 || fstat(r->fd, &st) != 0 || st.st_size == 0) {
+        snprintf(err, err_size, "cannot open or empty");
+        blog_reader_close(r);
+        return NULL;
+    }
+    r->size = st.st_size;
+    r->mtime = st.st_mtime;
+    void *map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+    if (map == MAP_FAILED) {
+        snprintf(err, err_size, "mmap failed");
+        blog_reader_close(r);
+        return NULL;
+    }
+    r->map = map;
+    madvise(map, r->size, MADV_SEQUENTIAL);
+
+    r->binary = r->size >= sizeof(blog_file_header_t) && memcmp(r->map, BLOG_MAGIC, 8) == 0;
+    if (!(r->binary ? bin_open(r, err, err_size) : csv_open(r, err, err_size))) {
+        blog_reader_close(r);
+        return NULL;
+    }
+    blog_reader_rewind(r);
+    return r;
+}
+
+void blog_reader_close(blog_reader_t *r)
+{
+    if (!r) return;
+    if (r->map) munmap((void *)r->map, r->size);
+    if (r->fd >= 0) close(r->fd);
+    free(r->index);
+    free(r->path);
+    free(r);
+}
+
+bool blog_reader_is_binary(const blog_reader_t *r)
+{
+    return r->binary;
+}
+
+int blog_reader_column_count(const blog_reader_t *r)
+{
+    return r->ncols;
+}
+
+const char *blog_reader_column_name(const blog_reader_t *r, int col)
+{
+    return (col >= 0 && col < r->ncols) ? r->names[col] : NULL;
+}
+
+int blog_reader_find_column(const blog_reader_t *r, const char *name)
+{
+    for (int i = 0; i < r->ncols; i++) {
+        if (strcmp(r->names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+void blog_reader_rewind(blog_reader_t *r)
+{
+    r->pos = r->data_start;
+    r->blk_count = r->blk_next = 0;
+    r->hold = false;
+    r->valid = false;
+}
+
+bool blog_reader_next(blog_reader_t *r)
+{
+    if (r->hold) {
+        r->hold = false;
+        return r->valid;
+    }
+    r->valid = r->binary ? bin_next(r) : csv_next(r);
+    return r->valid;
+}
+
+bool blog_reader_seek(blog_reader_t *r, uint32_t t_ms)
+{
+    ensure_index(r);
+    blog_reader_rewind(r);
+
+    // Last index point at or before t_ms
+    size_t lo = 0, hi = r->index_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->index[mid].t_ms <= t_ms) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0) r->pos = r->index[lo - 1].offset;
+
+    // At most one stride of records to walk
+    while (blog_reader_next(r)) {
+        if (r->t_ms >= t_ms) {
+            r->hold = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool blog_reader_time_range(blog_reader_t *r, uint32_t *first_ms, uint32_t *last_ms)
+{
+    ensure_index(r);
+    blog_reader_rewind(r);
+    if (!blog_reader_next(r)) return false;
+    *first_ms = *last_ms = r->t_ms;
+
+    // Only the last stride needs walking
+    if (r->index_count > 0) {
+        blog_reader_rewind(r);
+        r->pos = r->index[r->index_count - 1].offset;
+    }
+    while (blog_reader_next(r)) *last_ms = r->t_ms;
+    blog_reader_rewind(r);
+    return true;
+}
+
+uint32_t blog_reader_time_ms(const blog_reader_t *r)
+{
+    return r->t_ms;
+}
+
+double blog_reader_value(const blog_reader_t *r, int col)
+{
+    if (col < 0 || col >= r->ncols || !r->valid) return 0.0;
+    if (r->binary) return scale(r->vals[col], r->sig[col].exp10);
+
+    char buf[32];
+    size_t len = r->field_len[col + 1] < sizeof(buf) - 1 ? r->field_len[col + 1] : sizeof(buf) - 1;
+    memcpy(buf, r->field[col + 1], len);
+    buf[len] = '\0';
+    return strtod(buf, NULL);
+}
+
+const char *blog_reader_text(const blog_reader_t *r, int col, char *scratch, size_t *len)
+{
+    if (col < 0 || col >= r->ncols || !r->valid) {
+        *len = 0;
+        return scratch;
+    }
+    if (!r->binary) {
+        *len = r->field_len[col + 1];
+        return r->field[col + 1];
+    }
+
+    // Fixed point, e.g. 1234 with exp10 = -2 as 12.34
+    int32_t v = r->vals[col];
+    int8_t exp10 = r->sig[col].exp10;
+    int n;
+    if (exp10 >= 0) {
+        n = snprintf(scratch, 24, "%lld", (long long)(v * (int64_t)pow10_table[exp10 > 9 ? 9 : exp10]));
+    } else {
+        int64_t div = (int64_t)pow10_table[-exp10 > 9 ? 9 : -exp10];
+        int64_t mag = v < 0 ? -(int64_t)v : v;
+        n = snprintf(scratch, 24, "%s%lld.%0*lld", v < 0 ? "-" : "", (long long)(mag / div), -exp10,
+                     (long long)(mag % div));
+    }
+    *len = (n < 0) ? 0 : (size_t)n;
+    return scratch;
+}
+
+size_t blog_reader_bad_count(const blog_reader_t *r)
+{
+    return r->bad;
+}
@@ -0,0 +1,61 @@
+#pragma once
+// Random access reader for steering wheel logs, binary (log_N.bin) or CSV
+// (log_N.csv). The file is memory mapped, never read into RAM, so it works
+// on logs bigger than memory:
+//  - CSV fields are returned as slices of the mapping, no copies
+//  - binary blocks are decoded straight from the mapping, one at a time
+// Seeking goes through a sparse time index (one entry every
+// BLOG_INDEX_STRIDE bytes of log), bisected in O(log n) and then walked for
+// at most one stride. The index is built on the first seek by jumping
+// through the file, or loaded from <log>.idx if blog_reader_save_index()
+// wrote one earlier. Times are assumed non-decreasing within a file, which
+// holds for one session's log.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOG_INDEX_STRIDE   (64 * 1024)
+
+typedef struct blog_reader blog_reader_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NULL on failure, with the reason in err
+blog_reader_t *blog_reader_open(const char *path, char *err, size_t err_size);
+void blog_reader_close(blog_reader_t *r);
+
+bool blog_reader_is_binary(const blog_reader_t *r);
+int blog_reader_column_count(const blog_reader_t *r);
+const char *blog_reader_column_name(const blog_reader_t *r, int col);
+// Column number by name, -1 if missing
+int blog_reader_find_column(const blog_reader_t *r, const char *name);
+
+// Next record that will be returned has the first timestamp >= t_ms.
+// Returns false if there is none
+bool blog_reader_seek(blog_reader_t *r, uint32_t t_ms);
+// Back to the first record
+void blog_reader_rewind(blog_reader_t *r);
+// First and last record times through the index, false for a log without
+// records. Leaves the cursor rewound
+bool blog_reader_time_range(blog_reader_t *r, uint32_t *first_ms, uint32_t *last_ms);
+// Advances to the next record, false at the end of the file
+bool blog_reader_next(blog_reader_t *r);
+
+// Current record
+uint32_t blog_reader_time_ms(const blog_reader_t *r);
+double blog_reader_value(const blog_reader_t *r, int col);
+// Column text: a slice of the mapping for CSV, formatted into scratch
+// (at least 24 bytes) for binary. Not terminated
+const char *blog_reader_text(const blog_reader_t *r, int col, char *scratch, size_t *len);
+
+// Blocks skipped so far (binary: torn or stale), malformed lines for CSV
+size_t blog_reader_bad_count(const blog_reader_t *r);
+
+// Writes the index to <log>.idx, building it if needed
+bool blog_reader_save_index(blog_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,111 @@
+// Cuts a time range out of a steering wheel log, binary or CSV
+//   blog_slice [-s start_ms] [-e end_ms] [-c RPM,Volts,...] [-f csv|tsv]
+//              [-x] [-o out.csv] log_N.bin|log_N.csv
+// -s/-e: Time_ms range, start included, end excluded
+// -c:    only these columns, in this order
+// -x:    save the time index next to the log (<log>.idx) for later runs
+// Seeks through the index instead of reading the log from the start.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blog_reader.h"
+
+#define MAX_SELECTED    32
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: blog_slice [-s start_ms] [-e end_ms] [-c col,col] [-f csv|tsv] [-x] [-o output] log\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t start_ms = 0, end_ms = UINT32_MAX;
+    const char *cols = NULL;
+    const char *out_path = NULL;
+    const char *in_path = NULL;
+    char sep = ',';
+    bool save_index = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            start_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            end_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cols = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "csv") == 0) sep = ',';
+            else if (strcmp(f, "tsv") == 0) sep = '\t';
+            else usage();
+        } else if (strcmp(argv[i], "-x") == 0) {
+            save_index = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] == '-' || in_path) {
+            usage();
+        } else {
+            in_path = argv[i];
+        }
+    }
+    if (!in_path) usage();
+
+    char err[128];
+    blog_reader_t *r = blog_reader_open(in_path, err, sizeof(err));
+    if (!r) {
+        fprintf(stderr, "%s: %s\n", in_path, err);
+        return 1;
+    }
+
+    int selected[MAX_SELECTED];
+    int nsel = 0;
+    if (cols) {
+        char *list = strdup(cols);
+        for (char *name = strtok(list, ","); name && nsel < MAX_SELECTED; name = strtok(NULL, ",")) {
+            int c = blog_reader_find_column(r, name);
+            if (c < 0) {
+                fprintf(stderr, "%s: no column %s\n", in_path, name);
+                return 1;
+            }
+            selected[nsel++] = c;
+        }
+        free(list);
+    } else {
+        for (int c = 0; c < blog_reader_column_count(r) && nsel < MAX_SELECTED; c++) selected[nsel++] = c;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { perror(out_path); return 1; }
+
+    fprintf(out, "Time_ms");
+    for (int i = 0; i < nsel; i++) fprintf(out, "%c%s", sep, blog_reader_column_name(r, selected[i]));
+    fputc('\n', out);
+
+    size_t rows = 0;
+    bool have = (start_ms > 0) ? blog_reader_seek(r, start_ms) : true;
+    while (have && blog_reader_next(r)) {
+        uint32_t t = blog_reader_time_ms(r);
+        if (t >= end_ms) break;
+        fprintf(out, "%u", t);
+        for (int i = 0; i < nsel; i++) {
+            char scratch[24];
+            size_t len;
+            const char *text = blog_reader_text(r, selected[i], scratch, &len);
+            fputc(sep, out);
+            fwrite(text, 1, len, out);
+        }
+        fputc('\n', out);
+        rows++;
+    }
+
+    if (save_index && !blog_reader_save_index(r)) {
+        fprintf(stderr, "%s: could not save the index\n", in_path);
+    }
+    fprintf(stderr, "%s: %zu rows, %zu bad %s skipped\n", in_path, rows, blog_reader_bad_count(r),
+            blog_reader_is_binary(r) ? "blocks" : "lines");
+
+    blog_reader_close(r);
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Exports raw CAN captures (can_N.bin) to text
+//   can_export [-f candump|asc] [-i can0] [-o out.log] can_N.bin
+// candump: the `candump -l` log format, works with canplayer/log2asc
+// asc:     Vector ASCII, for CANalyzer/CANoe and most plotting tools
+// Drop and event markers become comments, corrupt blocks are skipped and
+// counted. Event files (EN/EVM.BIN) are read the same way.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "log_format.h"
+
+typedef enum { OUT_CANDUMP, OUT_ASC } out_format_t;
+
+// Controller health the device stored in the header block, if it did
+static void print_health(const char *path, const char *when, const bcan_health_t *h)
+{
+    // The device always fills in the queue length, time 0 is a valid boot snapshot
+    if (h->rx_queue_len == 0) return;
+    fprintf(stderr, "%s: CAN at %s (%.3f s): state %u, TEC %u (max %u), REC %u (max %u), "
+            "RX queue high water %u/%u, %u missed, %u overrun, %u arb lost, %u bus errors, "
+            "%u TX failed, %u bus-off\n",
+            path, when, h->timestamp_us / 1e6, h->state, h->tx_err, h->tx_err_max, h->rx_err, h->rx_err_max,
+            h->rx_queued_max, h->rx_queue_len, h->rx_missed, h->rx_overrun, h->arb_lost, h->bus_error,
+            h->tx_failed, h->bus_off);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: can_export [-f candump|asc] [-i iface] [-o output] can_N.bin\n");
+    exit(2);
+}
+
+static void print_candump(FILE *out, const char *iface, const bcan_record_t *r)
+{
+    fprintf(out, "(%010llu.%06llu) %s ", (unsigned long long)(r->timestamp_us / 1000000),
+            (unsigned long long)(r->timestamp_us % 1000000), iface);
+    if (r->can_id & BCAN_EFF_FLAG) fprintf(out, "%08X#", r->can_id & 0x1FFFFFFF);
+    else fprintf(out, "%03X#", r->can_id & 0x7FF);
+
+    if (r->can_id & BCAN_RTR_FLAG) {
+        fputc('R', out);
+    } else {
+        for (int i = 0; i < r->len && i < 8; i++) fprintf(out, "%02X", r->data[i]);
+    }
+    fputc('\n', out);
+}
+
+static void print_asc_header(FILE *out)
+{
+    time_t now = time(NULL);
+    char date[64];
+    strftime(date, sizeof(date), "%a %b %d %I:%M:%S.000 %p %Y", localtime(&now));
+    fprintf(out, "date %s\n", date);
+    fprintf(out, "base hex  timestamps absolute\n");
+    fprintf(out, "internal events logged\n");
+    fprintf(out, "Begin Triggerblock %s\n", date);
+}
+
+static void print_asc(FILE *out, uint64_t t0_us, const bcan_record_t *r)
+{
+    char id[16];
+    if (r->can_id & BCAN_EFF_FLAG) snprintf(id, sizeof(id), "%Xx", r->can_id & 0x1FFFFFFF);
+    else snprintf(id, sizeof(id), "%X", r->can_id & 0x7FF);
+
+    double t = (double)(r->timestamp_us - t0_us) / 1e6;
+    if (r->can_id & BCAN_RTR_FLAG) {
+        fprintf(out, "%11.6f 1  %-15s Rx   r\n", t, id);
+        return;
+    }
+    fprintf(out, "%11.6f 1  %-15s Rx   d %u", t, id, r->len);
+    for (int i = 0; i < r->len && i < 8; i++) fprintf(out, " %02X", r->data[i]);
+    fputc('\n', out);
+}
+
+// Bit order of sd_event_t in sd_logging.h
+static const char *event_names[] = { "manual", "alert", "box", "bus-off" };
+
+static void print_event(FILE *out, out_format_t fmt, uint64_t t0_us, const bcan_record_t *r, uint32_t reasons)
+{
+    if (fmt == OUT_ASC) {
+        fprintf(out, "// %.6f event:", (double)(r->timestamp_us - t0_us) / 1e6);
+    } else {
+        fprintf(out, "# (%010llu.%06llu) event:", (unsigned long long)(r->timestamp_us / 1000000),
+                (unsigned long long)(r->timestamp_us % 1000000));
+    }
+    for (unsigned i = 0; i < 32; i++) {
+        if (!(reasons & (1u << i))) continue;
+        if (i < sizeof(event_names) / sizeof(event_names[0])) fprintf(out, " %s", event_names[i]);
+        else fprintf(out, " %u", i);
+    }
+    fputc('\n', out);
+}
+
+int main(int argc, char **argv)
+{
+    out_format_t fmt = OUT_CANDUMP;
+    const char *iface = "can0";
+    const char *out_path = NULL;
+    const char *in_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "candump") == 0) fmt = OUT_CANDUMP;
+            else if (strcmp(f, "asc") == 0) fmt = OUT_ASC;
+            else usage();
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            iface = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] == '-' || in_path) {
+            usage();
+        } else {
+            in_path = argv[i];
+        }
+    }
+    if (!in_path) usage();
+
+    FILE *in = fopen(in_path, "rb");
+    if (!in) { perror(in_path); return 1; }
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { perror(out_path); return 1; }
+
+    uint8_t block[BLOG_BLOCK_SIZE];
+    blog_file_header_t hdr;
+    if (fread(block, 1, BLOG_BLOCK_SIZE, in) != BLOG_BLOCK_SIZE) {
+        fprintf(stderr, "%s: too short\n", in_path);
+        return 1;
+    }
+    memcpy(&hdr, block, sizeof(hdr));
+    if (memcmp(hdr.magic, BCAN_MAGIC, sizeof(hdr.magic)) != 0 || hdr.block_size != BLOG_BLOCK_SIZE ||
+        hdr.record_size != sizeof(bcan_record_t)) {
+        fprintf(stderr, "%s: not a raw CAN capture\n", in_path);
+        return 1;
+    }
+    if (hdr.version != BCAN_VERSION) {
+        fprintf(stderr, "%s: capture version %u, this tool reads version %u\n", in_path, hdr.version, BCAN_VERSION);
+        return 1;
+    }
+
+    bcan_health_t opened, closed;
+    memcpy(&opened, block + BCAN_HEALTH_OPEN_OFFSET, sizeof(opened));
+    memcpy(&closed, block + BCAN_HEALTH_CLOSE_OFFSET, sizeof(closed));
+
+    size_t frames = 0, blocks = 0, bad_blocks = 0;
+    unsigned long long lost = 0;
+    uint64_t t0_us = 0;
+    bool first = true;
+
+    if (fmt == OUT_ASC) print_asc_header(out);
+
+    while (fread(block, 1, BLOG_BLOCK_SIZE, in) == BLOG_BLOCK_SIZE) {
+        if (!blog_block_in_sequence(block, hdr.session, blocks++)) {
+            bad_blocks++;
+            continue;
+        }
+        blog_block_header_t bh;
+        memcpy(&bh, block, sizeof(bh));
+
+        for (int i = 0; i < bh.record_count && i < (int)BCAN_RECORDS_PER_BLOCK; i++) {
+            bcan_record_t r;
+            memcpy(&r, block + sizeof(bh) + i * sizeof(r), sizeof(r));
+            if (first) { t0_us = r.timestamp_us; first = false; }
+
+            if (r.can_id == BCAN_DROP_MARK) {
+                uint32_t n;
+                memcpy(&n, r.data, sizeof(n));
+                lost += n;
+                fprintf(out, "%s %u frames dropped by the logger here\n", fmt == OUT_ASC ? "//" : "#", n);
+                continue;
+            }
+            if (r.can_id == BCAN_EVENT_MARK) {
+                uint32_t reasons;
+                memcpy(&reasons, r.data, sizeof(reasons));
+                print_event(out, fmt, t0_us, &r, reasons);
+                continue;
+            }
+            if (fmt == OUT_ASC) print_asc(out, t0_us, &r);
+            else print_candump(out, iface, &r);
+            frames++;
+        }
+    }
+
+    if (fmt == OUT_ASC) fprintf(out, "End TriggerBlock\n");
+
+    fprintf(stderr, "%s: session %u, %zu frames, %llu dropped on device, %zu bad blocks skipped\n",
+            in_path, hdr.session, frames, lost, bad_blocks);
+    print_health(in_path, "open", &opened);
+    print_health(in_path, "close", &closed);
+
+    fclose(in);
+    if (out != stdout) fclose(out);
+    return bad_blocks ? 3 : 0;
+}
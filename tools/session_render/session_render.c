@@ -0,0 +1,428 @@
+// Replays a steering wheel log through the dashboard's own screens
+//   session_render [-m pilot|engineer|adventure|night] [-r fps] [-z scale]
+//                  [-s start_ms] [-e end_ms] [-j threads] [-f raw|pgm]
+//                  [-o out] log_N.bin|log_N.csv
+// raw: 8 bit grey frames, one after the other, to a file or stdout:
+//   session_render log_3.bin | ffmpeg -f rawvideo -pix_fmt gray -s 512x256 -r 30 -i - run.mp4
+// pgm: one frame_NNNNNN.pgm per frame in the -o directory
+// BOX calls are drawn from the Box column (logs without it have none). The
+// engineer CAN ID and bus pages come from live driver stats the log does not
+// hold: -m engineer draws the data page only
+//
+// Frame f is drawn for log time start + f / fps, with the records up to that
+// time fed through the same filter, alert and link timeout logic as the
+// main loop. A first pass runs only that logic over the whole log, from its
+// first record, and keeps the state at the start of every segment. A pool
+// of threads then draws the segments in parallel, each from its snapshot
+// with its own reader and framebuffer, so every frame is what one
+// sequential pass (and the wheel) would show. Segments are written out in
+// order, at most 2 per thread are held in memory.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "blog_reader.h"
+#include "log_record.h"
+#include "log_format.h"
+#include "dash_render.h"
+#include "ssd1309_gfx.h"
+
+#define SEGMENT_FRAMES  64
+#define MAX_THREADS     64
+
+typedef enum { OUT_RAW, OUT_PGM } out_format_t;
+
+// What the main loop carries from one record to the next
+typedef struct {
+    car_state_t car;
+    dash_filter_t filter;
+    alert_state_t alerts;
+    int64_t last_pkt_ms;
+} render_state_t;
+
+typedef enum { VIEW_PILOT, VIEW_ENGINEER, VIEW_ADVENTURE, VIEW_NIGHT } view_t;
+static const char *view_names[] = { "pilot", "engineer", "adventure", "night" };
+
+typedef struct {
+    // Settings
+    const char *log_path;
+    const char *out_path;
+    out_format_t format;
+    view_t view;
+    int scale;
+    double fps;
+    uint32_t start_ms;
+    uint32_t first_ms;      // Race timer zero, the first record
+    int64_t frames;
+    int width, height;
+    size_t frame_size;
+    render_state_t *snapshots;  // State before the first frame of each segment
+
+    // Work queue: segments are handed out in order, a slot is reused once
+    // the writer has taken the segment that was in it
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int64_t segments;
+    int64_t next_segment;
+    int64_t written;
+    int slots;
+    uint8_t **slot_buf;
+    bool *slot_done;
+    bool failed;
+} job_t;
+
+// Inverse of log_field_read(): a row back into the record the wheel logged
+static void record_from_row(const blog_reader_t *r, const int *cols, sd_log_record_t *rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->timestamp_ms = blog_reader_time_ms(r);
+    for (int i = 0; i < LOG_FIELD_COUNT; i++) {
+        if (cols[i] < 0) continue;
+        const log_field_t *f = &log_fields[i];
+        double v = blog_reader_value(r, cols[i]);
+        uint8_t *dst = (uint8_t *)rec + f->offset;
+        if (f->src_type == BLOG_F32) {
+            float fv = (float)v;
+            memcpy(dst, &fv, sizeof(fv));
+            continue;
+        }
+        long raw = lround(v * pow(10.0, -f->exp10));
+        switch (f->src_type) {
+            case BLOG_U8:  *dst = (uint8_t)raw; break;
+            case BLOG_U16: { uint16_t x = raw; memcpy(dst, &x, sizeof(x)); break; }
+            case BLOG_I16: { int16_t x = raw; memcpy(dst, &x, sizeof(x)); break; }
+            case BLOG_U32: { uint32_t x = raw; memcpy(dst, &x, sizeof(x)); break; }
+        }
+    }
+}
+
+// What can_update_state() would have handed the main loop for this record
+static void car_from_record(const sd_log_record_t *rec, car_state_t *car)
+{
+    car->rpm = rec->rpm;
+    car->speed = rec->speed;
+    car->fuel = rec->fuel;
+    car->roll = rec->roll;
+    car->pitch = rec->pitch;
+    car->cvt_temp = rec->cvt_temp;
+    car->eng_temp = rec->eng_temp;
+    car->voltage = rec->voltage;
+
+    // Same edge as the CAN decoder: a call going on or a new code is a new alert
+    bool on = rec->box_call != 0;
+    box_message message = on ? (rec->box_call - 1 < BOX_UNKNOWN ? (box_message)(rec->box_call - 1) : BOX_UNKNOWN)
+                             : car->box_alert_message;
+    if (on && (!car->box_alert || message != car->box_alert_message)) {
+        car->box_alert_time_us = (int64_t)rec->timestamp_ms * 1000;
+    }
+    car->box_alert = on;
+    car->box_alert_message = message;
+}
+
+static void draw_view(view_t view, uint8_t *fb, const car_state_t *car, const dash_ctx_t *ctx)
+{
+    switch (view) {
+        case VIEW_PILOT:     draw_pilot(fb, car, ctx); break;
+        case VIEW_ENGINEER:  draw_engineer(fb, car); break;
+        case VIEW_ADVENTURE: draw_adventure(fb, car); break;
+        case VIEW_NIGHT:     draw_night_mode(fb, car, ctx); break;
+    }
+}
+
+static void state_init(render_state_t *st)
+{
+    memset(st, 0, sizeof(*st));
+    alert_state_reset(&st->alerts);
+    st->last_pkt_ms = INT64_MIN / 2;
+}
+
+// The current record, as the main loop takes it in
+static void state_feed(render_state_t *st, const blog_reader_t *r, const int *cols)
+{
+    sd_log_record_t rec;
+    record_from_row(r, cols, &rec);
+    car_from_record(&rec, &st->car);
+    st->last_pkt_ms = rec.timestamp_ms;
+    dash_filter_apply(&st->filter, &st->car);
+    alert_state_update(&st->alerts, &st->car);
+}
+
+// Page ordered 1 bpp framebuffer to scale x scale grey pixels, lit = white
+static void upscale(const job_t *job, const uint8_t *fb, uint8_t *out)
+{
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        uint8_t *row = out + (size_t)y * job->scale * job->width;
+        const uint8_t *page = fb + (y / 8) * SCREEN_WIDTH;
+        int bit = y % 8;
+        uint8_t *p = row;
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            memset(p, (page[x] >> bit) & 1 ? 0xFF : 0x00, job->scale);
+            p += job->scale;
+        }
+        for (int k = 1; k < job->scale; k++) memcpy(row + (size_t)k * job->width, row, job->width);
+    }
+}
+
+static uint32_t frame_time_ms(const job_t *job, int64_t frame)
+{
+    return job->start_ms + (uint32_t)llround(frame * 1000.0 / job->fps);
+}
+
+static bool write_pgm(const job_t *job, int64_t frame, const uint8_t *pixels)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/frame_%06lld.pgm", job->out_path, (long long)frame);
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P5\n%d %d\n255\n", job->width, job->height);
+    bool ok = fwrite(pixels, 1, job->frame_size, f) == job->frame_size;
+    return (fclose(f) == 0) && ok;
+}
+
+// Renders frames [f0, f1) into out, frame after frame
+static bool render_segment(job_t *job, blog_reader_t *r, const int *cols, int64_t f0, int64_t f1, uint8_t *out)
+{
+    uint8_t fb[SSD1309_BUFFER_SIZE];
+    render_state_t st = job->snapshots[f0 / SEGMENT_FRAMES];
+
+    // The snapshot has every record before the first frame's time
+    bool have = blog_reader_seek(r, frame_time_ms(job, f0)) && blog_reader_next(r);
+
+    for (int64_t f = f0; f < f1; f++) {
+        uint32_t t = frame_time_ms(job, f);
+
+        // Every record up to the frame time, as the main loop saw them
+        while (have && blog_reader_time_ms(r) <= t) {
+            state_feed(&st, r, cols);
+            have = blog_reader_next(r);
+        }
+
+        dash_ctx_t ctx = {
+            .now_us = (int64_t)t * 1000,
+            .race_start_us = (int64_t)job->first_ms * 1000,
+            .alerts = st.alerts.active_mask,
+        };
+        if (t - st.last_pkt_ms > TIMEOUT_MS) {
+            draw_no_link(fb);
+        } else if (st.car.box_alert) {
+            // Shown at once on the first frame after the call, then it blinks
+            bool fresh = f == 0 || (int64_t)frame_time_ms(job, f - 1) * 1000 < st.car.box_alert_time_us;
+            if (fresh || dash_blink_phase(&ctx)) draw_box_alert(fb, &st.car);
+            else ssd1309_clear_buffer(fb);
+        } else {
+            st.car.link_active = true;
+            draw_view(job->view, fb, &st.car, &ctx);
+        }
+
+        uint8_t *pixels = out + (size_t)(f - f0) * job->frame_size;
+        upscale(job, fb, pixels);
+        if (job->format == OUT_PGM && !write_pgm(job, f, pixels)) return false;
+    }
+    return true;
+}
+
+static void *worker(void *arg)
+{
+    job_t *job = arg;
+    char err[128];
+    blog_reader_t *r = blog_reader_open(job->log_path, err, sizeof(err));
+    int cols[LOG_FIELD_COUNT];
+    for (int i = 0; r && i < LOG_FIELD_COUNT; i++) cols[i] = blog_reader_find_column(r, log_fields[i].name);
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int64_t s = job->next_segment++;
+        while (s < job->segments && s - job->written >= job->slots && !job->failed) {
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        bool stop = s >= job->segments || job->failed;
+        pthread_mutex_unlock(&job->lock);
+        if (stop) break;
+
+        int64_t f0 = s * SEGMENT_FRAMES;
+        int64_t f1 = f0 + SEGMENT_FRAMES < job->frames ? f0 + SEGMENT_FRAMES : job->frames;
+        bool ok = r && render_segment(job, r, cols, f0, f1, job->slot_buf[s % job->slots]);
+
+        pthread_mutex_lock(&job->lock);
+        if (!ok) job->failed = true;
+        job->slot_done[s % job->slots] = true;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+    blog_reader_close(r);
+    return NULL;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: session_render [-m pilot|engineer|adventure|night] [-r fps] [-z scale]\n"
+                    "                      [-s start_ms] [-e end_ms] [-j threads] [-f raw|pgm] [-o out] log\n"
+                    "BOX calls are replayed, the engineer CAN pages are not in the log\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    job_t job = {
+        .format = OUT_RAW,
+        .view = VIEW_NIGHT,
+        .scale = 4,
+        .fps = 30.0,
+    };
+    uint32_t start_ms = 0, end_ms = UINT32_MAX;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            const char *m = argv[++i];
+            int v = -1;
+            for (int k = 0; k < (int)(sizeof(view_names) / sizeof(view_names[0])); k++) {
+                if (strcmp(m, view_names[k]) == 0) v = k;
+            }
+            if (v < 0) usage();
+            job.view = (view_t)v;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            job.fps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+            job.scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            start_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            end_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "raw") == 0) job.format = OUT_RAW;
+            else if (strcmp(f, "pgm") == 0) job.format = OUT_PGM;
+            else usage();
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            job.out_path = argv[++i];
+        } else if (argv[i][0] == '-' || job.log_path) {
+            usage();
+        } else {
+            job.log_path = argv[i];
+        }
+    }
+    if (!job.log_path || job.fps <= 0 || job.scale < 1 || job.scale > 16) usage();
+    if (job.format == OUT_PGM && !job.out_path) {
+        fprintf(stderr, "pgm output needs a directory (-o)\n");
+        return 2;
+    }
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    // Range and columns, the workers open their own readers
+    char err[128];
+    blog_reader_t *r = blog_reader_open(job.log_path, err, sizeof(err));
+    if (!r) {
+        fprintf(stderr, "%s: %s\n", job.log_path, err);
+        return 1;
+    }
+    uint32_t last_ms;
+    if (!blog_reader_time_range(r, &job.first_ms, &last_ms)) {
+        fprintf(stderr, "%s: no records\n", job.log_path);
+        return 1;
+    }
+    int cols[LOG_FIELD_COUNT];
+    for (int i = 0; i < LOG_FIELD_COUNT; i++) {
+        cols[i] = blog_reader_find_column(r, log_fields[i].name);
+        if (cols[i] < 0) {
+            fprintf(stderr, "%s: no %s column, drawn as 0\n", job.log_path, log_fields[i].name);
+        }
+    }
+
+    job.start_ms = start_ms > job.first_ms ? start_ms : job.first_ms;
+    if (end_ms > last_ms) end_ms = last_ms + 1;
+    if (end_ms <= job.start_ms) {
+        fprintf(stderr, "%s: nothing between %u and %u ms\n", job.log_path, job.start_ms, end_ms);
+        return 1;
+    }
+    job.frames = (int64_t)ceil((end_ms - job.start_ms) * job.fps / 1000.0);
+    job.width = SCREEN_WIDTH * job.scale;
+    job.height = SCREEN_HEIGHT * job.scale;
+    job.frame_size = (size_t)job.width * job.height;
+    job.segments = (job.frames + SEGMENT_FRAMES - 1) / SEGMENT_FRAMES;
+
+    // Filter, alerts and link timeout only, no drawing: one cheap pass over
+    // the records from the first one, whatever the start time
+    job.snapshots = malloc(job.segments * sizeof(render_state_t));
+    if (!job.snapshots) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    render_state_t st;
+    state_init(&st);
+    blog_reader_rewind(r);
+    bool have = blog_reader_next(r);
+    for (int64_t s = 0; s < job.segments; s++) {
+        uint32_t t0 = frame_time_ms(&job, s * SEGMENT_FRAMES);
+        while (have && blog_reader_time_ms(r) < t0) {
+            state_feed(&st, r, cols);
+            have = blog_reader_next(r);
+        }
+        job.snapshots[s] = st;
+    }
+    blog_reader_close(r);
+
+    FILE *out = NULL;
+    if (job.format == OUT_RAW) {
+        out = job.out_path ? fopen(job.out_path, "wb") : stdout;
+        if (!out) { perror(job.out_path); return 1; }
+    }
+
+    job.slots = (int)threads * 2;
+    job.slot_buf = calloc(job.slots, sizeof(uint8_t *));
+    job.slot_done = calloc(job.slots, sizeof(bool));
+    for (int i = 0; i < job.slots; i++) {
+        job.slot_buf[i] = malloc(job.frame_size * SEGMENT_FRAMES);
+        if (!job.slot_buf[i]) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    pthread_t tid[MAX_THREADS];
+    for (long i = 0; i < threads; i++) pthread_create(&tid[i], NULL, worker, &job);
+
+    // Writer: segments go out in frame order whatever order they finish in
+    for (int64_t s = 0; s < job.segments; s++) {
+        int slot = s % job.slots;
+        pthread_mutex_lock(&job.lock);
+        while (!job.slot_done[slot] && !job.failed) pthread_cond_wait(&job.cond, &job.lock);
+        bool failed = job.failed;
+        pthread_mutex_unlock(&job.lock);
+        if (failed) break;
+
+        if (out) {
+            int64_t n = (s + 1) * SEGMENT_FRAMES < job.frames ? SEGMENT_FRAMES : job.frames - s * SEGMENT_FRAMES;
+            if (fwrite(job.slot_buf[slot], job.frame_size, n, out) != (size_t)n) {
+                perror("write");
+                pthread_mutex_lock(&job.lock);
+                job.failed = true;
+                pthread_mutex_unlock(&job.lock);
+            }
+        }
+
+        pthread_mutex_lock(&job.lock);
+        job.slot_done[slot] = false;
+        job.written++;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+    for (long i = 0; i < threads; i++) pthread_join(tid[i], NULL);
+
+    if (out && out != stdout) fclose(out);
+    else if (out) fflush(out);
+    if (job.failed) {
+        fprintf(stderr, "%s: rendering failed\n", job.log_path);
+        return 1;
+    }
+    fprintf(stderr, "%s: %lld frames %dx%d at %.3g fps, %ld threads, view %s\n", job.log_path,
+            (long long)job.frames, job.width, job.height, job.fps, threads, view_names[job.view]);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+// Same line format as the ESP32 console, on stderr so stdout stays free
+// for the simulator's own output
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+uint32_t esp_log_timestamp(void);
+int sim_log_level(void);
+
+#define SIM_LOG(level, letter, tag, fmt, ...) do {                                  \
+        if (sim_log_level() >= (level))                                             \
+            fprintf(stderr, letter " (%u) %s: " fmt "\n", (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__); \
+    } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) SIM_LOG(1, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) SIM_LOG(2, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) SIM_LOG(3, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) SIM_LOG(4, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) SIM_LOG(5, "V", tag, fmt, ##__VA_ARGS__)
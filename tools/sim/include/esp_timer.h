@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// Virtual microseconds since boot, see sim_freertos.c
+int64_t esp_timer_get_time(void);
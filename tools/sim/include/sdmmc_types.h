@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define SDMMC_FREQ_DEFAULT      20000
+#define SDMMC_FREQ_HIGHSPEED    40000
+#define SDMMC_FREQ_PROBING      400
+
+typedef struct {
+    uint32_t flags;
+    int slot;
+    int max_freq_khz;
+    float io_voltage;
+    esp_err_t (*set_card_clk)(int slot, uint32_t freq_khz);
+    int command_timeout_ms;
+} sdmmc_host_t;
+
+typedef struct {
+    int capacity;
+    int sector_size;
+} sdmmc_csd_t;
+
+typedef struct {
+    sdmmc_host_t host;
+    sdmmc_csd_t csd;
+    int real_freq_khz;
+} sdmmc_card_t;
@@ -0,0 +1,65 @@
+#pragma once
+// Host simulation controls: what the car, the pilot and the bench do to
+// the unmodified firmware running on the shims in tools/sim
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/twai.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// --- Storage ---
+// dir/sdcard is the card (MOUNT_POINT maps there), dir/nvs.txt the NVS
+// partition. NULL leaves the slot empty: mounting fails like without a card
+void sim_storage_init(const char *dir);
+// Files on the card, name relative to its root. false if there is no card
+bool sim_card_copy(const char *host_path, const char *name);
+bool sim_card_write(const char *name, const char *text);
+void sim_card_remove(const char *name);
+
+// --- CAN ---
+// Puts a frame on the bus as another node would. false if the controller
+// is not running, or the RX queue was full (counted as rx_missed)
+bool sim_can_inject(const twai_message_t *msg);
+// Oldest frame the firmware transmitted, false if there is none
+bool sim_can_take_tx(twai_message_t *msg);
+// Error counters past 255: the firmware has to notice and recover
+void sim_can_bus_off(void);
+// Deepest the RX queue has been since install
+uint32_t sim_can_rx_high_water(void);
+// Wire time of a frame at 500 kbit/s, stuff bits left out
+uint32_t sim_can_frame_us(const twai_message_t *msg);
+
+// --- GPIO ---
+// Drives an input pin (the button pulls GPIO 0 low)
+void sim_gpio_input(gpio_num_t pin, int level);
+int sim_gpio_output(gpio_num_t pin);
+
+// --- Panel ---
+// The SSD1309 on the I2C bus, rebuilt from the command and data stream
+typedef struct {
+    bool on;                // Display ON command seen last
+    uint32_t transactions;  // I2C transfers to the panel
+    uint64_t bytes;         // Bytes on the wire, control bytes included
+    uint64_t bus_us;        // What those transfers take at the SCL speed
+} sim_panel_stats_t;
+
+// GDDRAM in framebuffer layout (SSD1309_BUFFER_SIZE bytes)
+void sim_panel_read(uint8_t *gddram);
+void sim_panel_get_stats(sim_panel_stats_t *stats);
+// What the pilot sees, scale x scale pixels per panel pixel
+bool sim_panel_write_pgm(const char *path, int scale);
+
+// --- Clock ---
+// Virtual time against the wall clock: 0 runs flat out (the default), 1 is
+// real time. Set before vTaskStartScheduler()
+void sim_clock_set_speed(double speed);
+// Blocks the calling task until a virtual time in microseconds, off the
+// tick grid like a hardware timer would
+void sim_sleep_until(int64_t us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+#include "sim.h"
+#include "sim_private.h"
+
+#define NVS_MAX_KEYS    32
+#define NVS_MAX_HANDLES 8
+#define NVS_KEY_LEN     32      // "namespace.key"
+
+// --- Timer ---
+
+int64_t esp_timer_get_time(void)
+{
+    return sim_now_us();
+}
+
+// --- Log and errors ---
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// SIM_LOG_LEVEL=0..5, errors up to verbose, info by default
+int sim_log_level(void)
+{
+    static int level = -1;
+    if (level < 0) {
+        const char *env = getenv("SIM_LOG_LEVEL");
+        level = env ? atoi(env) : 3;
+    }
+    return level;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                    return "ESP_OK";
+        case ESP_FAIL:                  return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_FOUND:     return "ESP_ERR_NVS_NOT_FOUND";
+    }
+    return "UNKNOWN ERROR";
+}
+
+// Where the ESP32 would print a backtrace and reboot
+void sim_error_check_failed(esp_err_t rc, const char *file, int line, const char *expr)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nexpression: %s\n",
+            rc, esp_err_to_name(rc), file, line, expr);
+    abort();
+}
+
+// --- Heap ---
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    (void)caps;
+    if (alignment < sizeof(void *)) alignment = sizeof(void *);
+    void *p = NULL;
+    return posix_memalign(&p, alignment, size) == 0 ? p : NULL;
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+// --- NVS ---
+// The partition is a text file of "namespace.key value" lines, rewritten
+// on every commit so it survives between simulator runs like flash does
+
+typedef struct {
+    char key[NVS_KEY_LEN];
+    uint32_t value;
+} nvs_entry_t;
+
+static char nvs_path[1024];
+static nvs_entry_t nvs_entries[NVS_MAX_KEYS];
+static int nvs_count;
+static char nvs_namespaces[NVS_MAX_HANDLES][16];
+static bool nvs_ready;
+
+void sim_nvs_set_path(const char *path)
+{
+    snprintf(nvs_path, sizeof(nvs_path), "%s", path ? path : "");
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    nvs_count = 0;
+    FILE *f = nvs_path[0] ? fopen(nvs_path, "r") : NULL;
+    if (f) {
+        char key[NVS_KEY_LEN];
+        unsigned long value;
+        while (nvs_count < NVS_MAX_KEYS && fscanf(f, "%31s %lu", key, &value) == 2) {
+            snprintf(nvs_entries[nvs_count].key, NVS_KEY_LEN, "%s", key);
+            nvs_entries[nvs_count++].value = (uint32_t)value;
+        }
+        fclose(f);
+    }
+    nvs_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    nvs_count = 0;
+    if (nvs_path[0]) remove(nvs_path);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out_handle)
+{
+    (void)mode;
+    if (!nvs_ready) return ESP_ERR_INVALID_STATE;
+    for (int i = 0; i < NVS_MAX_HANDLES; i++) {
+        if (nvs_namespaces[i][0] == '\0') {
+            snprintf(nvs_namespaces[i], sizeof(nvs_namespaces[i]), "%s", name);
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static nvs_entry_t *nvs_find(nvs_handle_t handle, const char *key, bool create)
+{
+    char full[NVS_KEY_LEN];
+    snprintf(full, sizeof(full), "%s.%s", nvs_namespaces[handle - 1], key);
+    for (int i = 0; i < nvs_count; i++) {
+        if (strcmp(nvs_entries[i].key, full) == 0) return &nvs_entries[i];
+    }
+    if (!create || nvs_count == NVS_MAX_KEYS) return NULL;
+    nvs_entry_t *e = &nvs_entries[nvs_count++];
+    snprintf(e->key, sizeof(e->key), "%s", full);
+    e->value = 0;
+    return e;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    if (handle < 1 || handle > NVS_MAX_HANDLES) return ESP_ERR_INVALID_ARG;
+    nvs_entry_t *e = nvs_find(handle, key, false);
+    if (e) *out_value = e->value;
+    return e ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    if (handle < 1 || handle > NVS_MAX_HANDLES) return ESP_ERR_INVALID_ARG;
+    nvs_entry_t *e = nvs_find(handle, key, true);
+    if (e) e->value = value;
+    return e ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    if (!nvs_path[0]) return ESP_OK;
+    FILE *f = fopen(nvs_path, "w");
+    for (int i = 0; f && i < nvs_count; i++) {
+        fprintf(f, "%s %lu\n", nvs_entries[i].key, (unsigned long)nvs_entries[i].value);
+    }
+    bool ok = f && fclose(f) == 0;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    if (handle < 1 || handle > NVS_MAX_HANDLES) return;
+    nvs_namespaces[handle - 1][0] = '\0';
+}
@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sim.h"
+#include "sim_private.h"
+
+// One core, one task at a time. Every task is a thread, but only the one
+// holding the CPU runs; it gives the CPU away when it blocks, yields or
+// wakes a higher priority task, like the FreeRTOS scheduler does at those
+// points. Running code takes no virtual time: the clock only moves when
+// every task is blocked, straight to the earliest timeout. Same inputs,
+// same interleaving, same timestamps, at whatever speed the host manages
+
+#define TICK_US     (portTICK_PERIOD_MS * 1000LL)
+
+typedef enum {
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_SUSPENDED,     // Also what is left of a task that returned
+} task_state_t;
+
+struct sim_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t priority;
+    pthread_cond_t cond;        // Signalled when the task gets the CPU
+    task_state_t state;
+    uint64_t ready_seq;         // FIFO among ready tasks of one priority
+    const void *wait_obj;       // What a blocked task waits on, see sim_wake()
+    int64_t wake_us;            // Its timeout, INT64_MAX for none
+    bool timed_out;
+    uint32_t notify;
+    struct sim_task *next;      // All tasks, in creation order
+};
+
+struct sim_sem {
+    uint32_t count;
+    uint32_t max;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sim_task *tasks;
+static struct sim_task **tasks_tail = &tasks;
+static struct sim_task *running;
+static __thread struct sim_task *current;
+static uint64_t ready_seq = 1;      // 0 is kept for a preempted task
+static bool started;
+static int64_t now_us;
+static double speed;                // 0 = as fast as possible
+static struct timespec wall_start;
+static const char sleep_obj;        // Never woken, for plain timeouts
+
+// --- Scheduler, caller holds the lock ---
+
+static void make_ready(struct sim_task *t)
+{
+    t->state = TASK_READY;
+    t->ready_seq = ready_seq++;
+    t->wait_obj = NULL;
+}
+
+static struct sim_task *pick(void)
+{
+    struct sim_task *best = NULL;
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (t->state != TASK_READY) continue;
+        if (!best || t->priority > best->priority ||
+            (t->priority == best->priority && t->ready_seq < best->ready_seq)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// Keeps virtual time from running ahead of the wall clock scaled by speed
+static void pace(int64_t target_us)
+{
+    if (speed <= 0) return;
+    uint64_t ns = (uint64_t)(target_us / speed * 1000.0) + wall_start.tv_nsec;
+    struct timespec ts = {
+        .tv_sec = wall_start.tv_sec + ns / 1000000000ULL,
+        .tv_nsec = ns % 1000000000ULL,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+// Hands the CPU to the next task, moving the clock if nothing is ready
+static void dispatch(void)
+{
+    struct sim_task *next;
+    while ((next = pick()) == NULL) {
+        int64_t wake = INT64_MAX;
+        for (struct sim_task *t = tasks; t; t = t->next) {
+            if (t->state == TASK_BLOCKED && t->wake_us < wake) wake = t->wake_us;
+        }
+        if (wake == INT64_MAX) {
+            fprintf(stderr, "sim: every task is blocked for good at %lld us\n", (long long)now_us);
+            exit(1);
+        }
+        pace(wake);
+        now_us = wake;
+        for (struct sim_task *t = tasks; t; t = t->next) {
+            if (t->state == TASK_BLOCKED && t->wake_us <= now_us) {
+                make_ready(t);
+                t->timed_out = true;
+            }
+        }
+    }
+    next->state = TASK_RUNNING;
+    running = next;
+    pthread_cond_signal(&next->cond);
+}
+
+// Gives the CPU away and waits to get it back. self is no longer running
+static void reschedule(struct sim_task *self)
+{
+    dispatch();
+    while (self->state != TASK_RUNNING) pthread_cond_wait(&self->cond, &lock);
+}
+
+// Called after making tasks ready: a higher priority one runs right away
+static void preempt(void)
+{
+    struct sim_task *self = current;
+    if (!started || !self || self != running) return;
+    struct sim_task *next = pick();
+    if (!next || next->priority <= self->priority) return;
+    self->state = TASK_READY;
+    self->ready_seq = 0;        // First of its priority once it is ready again
+    reschedule(self);
+}
+
+static struct sim_task *self_task(void)
+{
+    if (!current || current != running) {
+        fprintf(stderr, "sim: blocking call outside a task\n");
+        abort();
+    }
+    return current;
+}
+
+// --- Used by the other shims ---
+
+int64_t sim_now_us(void)
+{
+    return now_us;
+}
+
+int64_t sim_tick_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return INT64_MAX;
+    return (now_us / TICK_US + ticks) * TICK_US;
+}
+
+bool sim_wait(const void *obj, int64_t deadline_us)
+{
+    pthread_mutex_lock(&lock);
+    struct sim_task *t = self_task();
+    bool woken = false;
+    if (deadline_us > now_us) {
+        t->state = TASK_BLOCKED;
+        t->wait_obj = obj;
+        t->wake_us = deadline_us;
+        t->timed_out = false;
+        reschedule(t);
+        woken = !t->timed_out;
+    }
+    pthread_mutex_unlock(&lock);
+    return woken;
+}
+
+void sim_wake(const void *obj)
+{
+    pthread_mutex_lock(&lock);
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (t->state == TASK_BLOCKED && t->wait_obj == obj) make_ready(t);
+    }
+    preempt();
+    pthread_mutex_unlock(&lock);
+}
+
+void sim_clock_set_speed(double s)
+{
+    speed = s;
+}
+
+void sim_sleep_until(int64_t us)
+{
+    sim_wait(&sleep_obj, us);
+}
+
+// --- Tasks ---
+
+static void *task_entry(void *p)
+{
+    struct sim_task *t = p;
+    current = t;
+    pthread_setname_np(pthread_self(), t->name);
+    pthread_mutex_lock(&lock);
+    while (t->state != TASK_RUNNING) pthread_cond_wait(&t->cond, &lock);
+    pthread_mutex_unlock(&lock);
+
+    t->fn(t->arg);
+
+    // Returning from a task is a bug on the ESP32, here the thread just ends
+    fprintf(stderr, "sim: task %s returned\n", t->name);
+    pthread_mutex_lock(&lock);
+    t->state = TASK_SUSPENDED;
+    dispatch();
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id)
+{
+    (void)stack_depth; (void)core_id;
+    struct sim_task *t = calloc(1, sizeof(*t));
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    t->priority = priority < configMAX_PRIORITIES ? priority : configMAX_PRIORITIES - 1;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "task");
+    pthread_cond_init(&t->cond, NULL);
+
+    pthread_mutex_lock(&lock);
+    t->state = TASK_SUSPENDED;  // Not schedulable until the thread exists
+    if (pthread_create(&t->thread, NULL, task_entry, t) != 0) {
+        pthread_mutex_unlock(&lock);
+        free(t);
+        return pdFAIL;
+    }
+    pthread_detach(t->thread);
+    *tasks_tail = t;
+    tasks_tail = &t->next;
+    make_ready(t);
+    if (created_task) *created_task = t;
+    preempt();
+    pthread_mutex_unlock(&lock);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created_task)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskStartScheduler(void)
+{
+    pthread_mutex_lock(&lock);
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    started = true;
+    dispatch();
+    // The calling thread is not a task, it just stays out of the way
+    pthread_cond_t never;
+    pthread_cond_init(&never, NULL);
+    for (;;) pthread_cond_wait(&never, &lock);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task && task != current) {
+        fprintf(stderr, "sim: deleting another task is not supported\n");
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    current->state = TASK_SUSPENDED;
+    dispatch();
+    pthread_mutex_unlock(&lock);
+    pthread_exit(NULL);
+}
+
+// The task stops where it is: blocked in a call, or at its next
+// instruction if it was ready. There is no vTaskResume
+void vTaskSuspend(TaskHandle_t task)
+{
+    pthread_mutex_lock(&lock);
+    struct sim_task *t = task ? task : self_task();
+    t->state = TASK_SUSPENDED;
+    if (t == current) reschedule(t);
+    pthread_mutex_unlock(&lock);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) {
+        pthread_mutex_lock(&lock);
+        struct sim_task *t = self_task();
+        make_ready(t);
+        reschedule(t);
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    sim_wait(&sleep_obj, sim_tick_deadline(ticks));
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us / TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notify++;
+    sim_wake(&task->notify);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct sim_task *t = current;
+    int64_t deadline = sim_tick_deadline(ticks_to_wait);
+    while (t->notify == 0 && sim_wait(&t->notify, deadline)) {
+    }
+    uint32_t value = t->notify;
+    if (clear_on_exit) t->notify = 0;
+    else if (value) t->notify--;
+    return value;
+}
+
+// --- Semaphores ---
+
+static struct sim_sem *sem_new(uint32_t max, uint32_t initial)
+{
+    struct sim_sem *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->max = max;
+    s->count = initial;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_new(1, 0);
+}
+
+// No priority inheritance or recursion, the firmware needs neither
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_new(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    int64_t deadline = sim_tick_deadline(ticks_to_wait);
+    while (sem->count == 0 && sim_wait(sem, deadline)) {
+    }
+    if (sem->count == 0) return pdFALSE;
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count >= sem->max) return pdFALSE;
+    sem->count++;
+    sim_wake(sem);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+// --- Critical sections ---
+// Nothing else runs until the task blocks, there is nothing to keep out
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+}
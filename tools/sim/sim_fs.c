@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+#include "driver/spi_common.h"
+#include "sim.h"
+#include "sim_private.h"
+
+// The firmware's file calls are linked with -Wl,--wrap=<name>: paths under
+// the mount point go to the card directory, anything else is untouched.
+// Nothing in the firmware sources changes for this
+
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_stat(const char *path, struct stat *st);
+DIR *__real_opendir(const char *path);
+int __real_remove(const char *path);
+int __real_mkdir(const char *path, mode_t mode);
+
+static char card_dir[1024];     // Empty = no card in the slot
+static char mount_point[64];    // Empty = not mounted
+static sdmmc_card_t card;
+
+void sim_storage_init(const char *dir)
+{
+    card_dir[0] = '\0';
+    if (!dir) {
+        sim_nvs_set_path(NULL);
+        return;
+    }
+    char path[1024];
+    mkdir(dir, 0777);
+    snprintf(path, sizeof(path), "%s/nvs.txt", dir);
+    sim_nvs_set_path(path);
+    snprintf(card_dir, sizeof(card_dir), "%s/sdcard", dir);
+    mkdir(card_dir, 0777);
+}
+
+static bool card_path(const char *name, char *buf, size_t size)
+{
+    if (card_dir[0] == '\0') return false;
+    return (size_t)snprintf(buf, size, "%s/%s", card_dir, name) < size;
+}
+
+bool sim_card_copy(const char *host_path, const char *name)
+{
+    char path[1024];
+    if (!card_path(name, path, sizeof(path))) return false;
+    FILE *in = __real_fopen(host_path, "rb");
+    FILE *out = in ? __real_fopen(path, "wb") : NULL;
+    bool ok = out != NULL;
+    char buf[16384];
+    size_t n;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) ok = fwrite(buf, 1, n, out) == n;
+    if (in) fclose(in);
+    if (out && fclose(out) != 0) ok = false;
+    return ok;
+}
+
+bool sim_card_write(const char *name, const char *text)
+{
+    char path[1024];
+    if (!card_path(name, path, sizeof(path))) return false;
+    FILE *f = __real_fopen(path, "w");
+    if (!f) return false;
+    fputs(text, f);
+    return fclose(f) == 0;
+}
+
+void sim_card_remove(const char *name)
+{
+    char path[1024];
+    if (card_path(name, path, sizeof(path))) __real_remove(path);
+}
+
+// Host path for a firmware path, or the path itself if not on the card
+static const char *map_path(const char *path, char *buf, size_t size)
+{
+    size_t n = strlen(mount_point);
+    if (n == 0 || strncmp(path, mount_point, n) != 0 || (path[n] != '/' && path[n] != '\0')) return path;
+    snprintf(buf, size, "%s%s", card_dir, path + n);
+    return buf;
+}
+
+FILE *__wrap_fopen(const char *path, const char *mode)
+{
+    char buf[1024];
+    return __real_fopen(map_path(path, buf, sizeof(buf)), mode);
+}
+
+int __wrap_stat(const char *path, struct stat *st)
+{
+    char buf[1024];
+    return __real_stat(map_path(path, buf, sizeof(buf)), st);
+}
+
+DIR *__wrap_opendir(const char *path)
+{
+    char buf[1024];
+    return __real_opendir(map_path(path, buf, sizeof(buf)));
+}
+
+int __wrap_remove(const char *path)
+{
+    char buf[1024];
+    return __real_remove(map_path(path, buf, sizeof(buf)));
+}
+
+int __wrap_mkdir(const char *path, mode_t mode)
+{
+    char buf[1024];
+    return __real_mkdir(map_path(path, buf, sizeof(buf)), mode);
+}
+
+// --- SPI / SD card ---
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t *bus_config, spi_common_dma_t dma_chan)
+{
+    (void)host_id; (void)bus_config; (void)dma_chan;
+    return ESP_OK;
+}
+
+esp_err_t sdspi_host_set_card_clk(int slot, uint32_t freq_khz)
+{
+    (void)slot;
+    card.real_freq_khz = freq_khz;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base_path, const sdmmc_host_t *host_config,
+                                  const sdspi_device_config_t *slot_config,
+                                  const esp_vfs_fat_mount_config_t *mount_config, sdmmc_card_t **out_card)
+{
+    (void)slot_config; (void)mount_config;
+    struct stat st;
+    if (card_dir[0] == '\0' || __real_stat(card_dir, &st) != 0 || !S_ISDIR(st.st_mode)) return ESP_FAIL;
+    snprintf(mount_point, sizeof(mount_point), "%s", base_path);
+    card.host = *host_config;
+    card.csd.sector_size = 512;
+    card.csd.capacity = 0x1000000;  // 8 GB in sectors
+    card.real_freq_khz = host_config->max_freq_khz;
+    *out_card = &card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base_path, sdmmc_card_t *sd_card)
+{
+    (void)base_path; (void)sd_card;
+    mount_point[0] = '\0';
+    return ESP_OK;
+}
+
+// No FAT chain to lay out: a file of that size, holes read back as zeros
+esp_err_t esp_vfs_fat_create_contiguous_file(const char *base_path, const char *full_path, uint64_t size, bool alloc_now)
+{
+    (void)base_path; (void)alloc_now;
+    char buf[1024];
+    int fd = open(map_path(full_path, buf, sizeof(buf)), O_CREAT | O_TRUNC | O_WRONLY, 0666);
+    if (fd < 0) return ESP_FAIL;
+    bool ok = ftruncate(fd, (off_t)size) == 0;
+    close(fd);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+// Raw sectors are only read for the clock test, which compares reads with
+// each other: a fixed pattern per sector is enough
+esp_err_t sdmmc_read_sectors(sdmmc_card_t *sd_card, void *dst, size_t start_sector, size_t sector_count)
+{
+    (void)sd_card;
+    uint8_t *p = dst;
+    for (size_t s = 0; s < sector_count; s++) {
+        for (int i = 0; i < 512; i++) *p++ = (uint8_t)((start_sector + s) * 31 + i);
+    }
+    return ESP_OK;
+}
+
+esp_err_t sdmmc_write_sectors(sdmmc_card_t *sd_card, const void *src, size_t start_sector, size_t sector_count)
+{
+    (void)sd_card; (void)src; (void)start_sector; (void)sector_count;
+    return ESP_OK;
+}
@@ -0,0 +1,327 @@
+// Runs the steering wheel firmware on the host, headless
+//   firmware_sim [-t seconds] [-x speed] [-d dir] [-n] [-b at_ms[:hold_ms]]...
+//                [-a at_ms[:hold_ms[:code]]]... [-o panel.pgm] [-z scale] [-r capture[:speed]] [-s stress.cfg text]
+// -t: how long to run, in virtual time (10 s)
+// -x: virtual seconds per wall second, 0 for as fast as possible (0)
+// -d: simulator state: dir/sdcard is the card, dir/nvs.txt the NVS (sim_out)
+// -n: no SD card in the slot
+// -b: button press at at_ms, held hold_ms (100), contact bounce included.
+//     The first gesture leaves the splash screen, a press at 300 ms is added
+//     if none is given. Two presses under 250 ms apart are a double press
+// -a: the COM ECU calls the pilot in at at_ms for hold_ms (1000), code as
+//     in box_message (0). The frame repeats every 100 ms while the call is on
+// -o: what the panel shows at the end, as a PGM
+// -r: replay a capture (can_N.bin, candump .log or .asc) instead of running
+//     the ECU, speed 0 as fast as the bus takes it (1). The firmware finds
+//     it on the card and sends it through self reception
+// -s: run the CAN stress test instead of the ECU, settings as in stress.cfg
+//     with ';' between them ("" for the defaults). Prints the curve
+// A synthetic ECU puts the usual traffic on the bus. The firmware is
+// stopped cleanly at the end (logger drained, files closed) so the card
+// holds a complete session. Runs are deterministic: same arguments, same
+// card contents. SIM_LOG_LEVEL=0..5 sets the console verbosity.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "can_management.h"
+#include "sd_logging.h"
+#include "can_replay.h"
+#include "can_stress.h"
+#include "can_tx.h"
+#include "button_input.h"
+#include "sim.h"
+
+#define SIM_ECU_PERIOD_MS   10      // Fast signals at 100 Hz
+#define SIM_SLOW_EVERY      10      // Temperatures, fuel, battery at 10 Hz
+#define SIM_MAX_PRESSES     32
+#define SIM_MAX_ALERTS      16
+#define SIM_BUTTON          GPIO_NUM_0
+#define SIM_BOUNCES         3       // Contact bounces on every button edge
+#define SIM_BOUNCE_US       400     // Apart
+// The car and the bench are outside the ESP32, nothing on it delays them
+#define SIM_OUTSIDE_PRIO    (configMAX_PRIORITIES - 1)
+
+void app_main(void);
+
+typedef struct {
+    uint32_t at_ms;
+    uint32_t hold_ms;
+} press_t;
+
+typedef struct {
+    uint32_t at_ms;
+    uint32_t hold_ms;
+    uint8_t code;
+} alert_t;
+
+static struct {
+    double seconds;
+    const char *pgm;
+    int scale;
+    press_t presses[SIM_MAX_PRESSES];
+    int npress;
+    alert_t alerts[SIM_MAX_ALERTS];
+    int nalert;
+    const char *replay;
+    const char *replay_speed;
+    const char *stress;
+    TaskHandle_t app;
+} run;
+
+static struct timespec run_wall;
+static uint32_t frames_sent;
+static uint32_t frames_refused;
+
+static void send(uint32_t id, const void *data, uint8_t len)
+{
+    twai_message_t msg = { .identifier = id, .data_length_code = len };
+    memcpy(msg.data, data, len);
+    if (sim_can_inject(&msg)) frames_sent++;
+    else frames_refused++;
+    // Back to back frames still take their time on the wire
+    sim_sleep_until(esp_timer_get_time() + sim_can_frame_us(&msg));
+}
+
+static void send_u16(uint32_t id, uint16_t v)
+{
+    uint8_t d[2] = { v & 0xFF, v >> 8 };
+    send(id, d, sizeof(d));
+}
+
+// The BOX alert the COM ECU should be sending at now_ms, if any
+static const alert_t *alert_at(uint32_t now_ms)
+{
+    for (int i = 0; i < run.nalert; i++) {
+        const alert_t *a = &run.alerts[i];
+        if (now_ms >= a->at_ms && now_ms - a->at_ms < a->hold_ms) return a;
+    }
+    return NULL;
+}
+
+// A lap every minute: speed and rpm swing, engine warms up, fuel goes down
+static void ecu_task(void *arg)
+{
+    (void)arg;
+    const alert_t *was = NULL;
+    for (uint32_t n = 0;; n++) {
+        double t = esp_timer_get_time() / 1e6;
+        // Sent on every change, then repeated like any periodic frame
+        const alert_t *alert = alert_at((uint32_t)(esp_timer_get_time() / 1000));
+        if (alert != was || (alert && n % SIM_SLOW_EVERY == 0)) {
+            uint8_t box[2] = { alert ? 1 : 0, alert ? alert->code : 0 };
+            send(ID_BOX_ALERT, box, sizeof(box));
+            was = alert;
+        }
+        double lap = sin(t * 2 * M_PI / 60.0);
+        send_u16(ID_RPM, (uint16_t)(2700 + 900 * lap));
+        send_u16(ID_SPEED, (uint16_t)(28 + 22 * lap));
+        if (n % SIM_SLOW_EVERY == 0) {
+            uint8_t cvt = (uint8_t)(60 + 25 * (1 - exp(-t / 120)));
+            uint8_t eng = (uint8_t)(70 + 25 * (1 - exp(-t / 90)));
+            float volts = 12.6f - 0.05f * (float)lap;
+            send(ID_CVT_TEMP, &cvt, 1);
+            send(ID_ENG_TEMP, &eng, 1);
+            send(ID_VOLTAGE, &volts, sizeof(volts));
+            send_u16(ID_FUEL, (uint16_t)(t < 5400 ? 100 - t / 60 : 10));
+        }
+        vTaskDelay(pdMS_TO_TICKS(SIM_ECU_PERIOD_MS));
+    }
+}
+
+static void main_task(void *arg)
+{
+    (void)arg;
+    app_main();
+}
+
+static int cmp_press(const void *a, const void *b)
+{
+    const press_t *pa = a, *pb = b;
+    return (pa->at_ms > pb->at_ms) - (pa->at_ms < pb->at_ms);
+}
+
+static void print_stress(void)
+{
+    can_stress_step_t steps[CAN_STRESS_MAX_STEPS];
+    int n = can_stress_get_results(steps, CAN_STRESS_MAX_STEPS);
+    printf("stress: %s, %d steps, rx queue %d\n", can_stress_running() ? "running" : "done", n, CAN_RX_QUEUE_LEN);
+    printf("  load%%   bus%%  offered     sent  decoded   lost  other overrun  rxq_hw  lat_avg  lat_max\n");
+    for (int i = 0; i < n; i++) {
+        const can_stress_step_t *s = &steps[i];
+        printf("  %5u  %5u  %7lu  %7lu  %7lu  %5lu  %5lu  %6lu  %6lu  %7lu  %7lu\n", s->load_pct, s->bus_load_pct,
+               (unsigned long)s->frames_offered, (unsigned long)s->frames_sent, (unsigned long)s->frames_decoded,
+               (unsigned long)(s->frames_sent - s->frames_decoded), (unsigned long)s->frames_other,
+               (unsigned long)s->rx_overruns,
+               (unsigned long)s->rx_high_water, (unsigned long)s->latency_avg_us, (unsigned long)s->latency_max_us);
+    }
+}
+
+// The button's contact chatters a few times before it settles on level
+static void button_edge(int level, int64_t at_us)
+{
+    sim_sleep_until(at_us);
+    for (int i = 0; i < SIM_BOUNCES; i++) {
+        sim_gpio_input(SIM_BUTTON, level);
+        sim_sleep_until(at_us += SIM_BOUNCE_US);
+        sim_gpio_input(SIM_BUTTON, !level);
+        sim_sleep_until(at_us += SIM_BOUNCE_US);
+    }
+    sim_gpio_input(SIM_BUTTON, level);
+}
+
+// The pilot and the end of the run
+static void bench_task(void *arg)
+{
+    (void)arg;
+    int64_t end_us = (int64_t)(run.seconds * 1e6);
+    for (int i = 0; i < run.npress; i++) {
+        int64_t at = run.presses[i].at_ms * 1000LL;
+        if (at >= end_us) break;
+        button_edge(0, at);
+        button_edge(1, at + run.presses[i].hold_ms * 1000LL);
+    }
+    sim_sleep_until(end_us);
+
+    // Key off: stop the main loop where it is, then close the logs
+    vTaskSuspend(run.app);
+    sd_logging_deinit();
+
+    if (run.pgm && !sim_panel_write_pgm(run.pgm, run.scale)) perror(run.pgm);
+
+    sim_panel_stats_t panel;
+    sim_panel_get_stats(&panel);
+    struct timespec wall;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    double wall_s = wall.tv_sec - run_wall.tv_sec + (wall.tv_nsec - run_wall.tv_nsec) / 1e9;
+    printf("ran %.3f s in %.3f s of wall time\n", esp_timer_get_time() / 1e6, wall_s);
+    printf("can: %lu frames sent, %lu refused, rx queue high water %lu, %lu bus-off\n",
+           (unsigned long)frames_sent, (unsigned long)frames_refused,
+           (unsigned long)sim_can_rx_high_water(), (unsigned long)can_bus_off_count());
+    can_tx_stats_t tx;
+    can_tx_get_stats(&tx);
+    printf("can tx: %lu status, %lu requests, %lu emergency, max %lu frames/s, %lu deferred, %lu refused\n",
+           (unsigned long)tx.status_sent, (unsigned long)tx.request_sent, (unsigned long)tx.emergency_sent,
+           (unsigned long)tx.rate_max, (unsigned long)tx.deferred, (unsigned long)tx.refused);
+    button_stats_t bs;
+    button_get_stats(&bs);
+    printf("button: %lu short, %lu long, %lu double, %lu edges, %lu dropped\n",
+           (unsigned long)bs.shorts, (unsigned long)bs.longs, (unsigned long)bs.doubles,
+           (unsigned long)bs.edges, (unsigned long)bs.dropped);
+    if (run.replay) {
+        can_replay_stats_t rs;
+        can_replay_get_stats(&rs);
+        double s = rs.elapsed_us / 1e6;
+        printf("replay: %s, %lu frames sent, %lu decoded, %lu tx errors, %lu skipped in %.3f s, %.0f frames/s decoded\n",
+               rs.running ? "running" : "done", (unsigned long)rs.frames_sent, (unsigned long)rs.frames_decoded,
+               (unsigned long)rs.tx_errors, (unsigned long)rs.skipped, s, s > 0 ? rs.frames_decoded / s : 0);
+    }
+    if (run.stress) print_stress();
+    printf("panel: %s, %lu transfers, %llu bytes, %.1f ms of bus time\n", panel.on ? "on" : "off",
+           (unsigned long)panel.transactions, (unsigned long long)panel.bytes, panel.bus_us / 1000.0);
+    fflush(stdout);
+    // The remaining tasks never return, take them down with the process
+    exit(0);
+}
+
+// Puts the capture or the stress settings where the firmware looks for
+// them, or clears what an earlier run left there
+static bool stage_bench_files(void)
+{
+    static const char *names[] = CAN_REPLAY_NAMES;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) sim_card_remove(names[i]);
+    sim_card_remove(CAN_REPLAY_CONFIG);
+    sim_card_remove(CAN_STRESS_CONFIG);
+    if (run.stress) return sim_card_write(CAN_STRESS_CONFIG, run.stress);
+    if (!run.replay) return true;
+
+    // By extension, anything else is taken for a raw capture
+    const char *ext = strrchr(run.replay, '.');
+    const char *name = names[0];
+    if (ext && strcmp(ext, ".log") == 0) name = names[1];
+    else if (ext && strcmp(ext, ".asc") == 0) name = names[2];
+    if (!sim_card_copy(run.replay, name)) return false;
+    if (run.replay_speed) {
+        char cfg[32];
+        snprintf(cfg, sizeof(cfg), "speed %s\n", run.replay_speed);
+        if (!sim_card_write(CAN_REPLAY_CONFIG, cfg)) return false;
+    }
+    return true;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: firmware_sim [-t seconds] [-x speed] [-d dir] [-n] [-b at_ms[:hold_ms]]... [-a at_ms[:hold_ms[:code]]]... [-o panel.pgm] [-z scale] [-r capture[:speed]] [-s stress.cfg text]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = "sim_out";
+    bool no_card = false;
+    double speed = 0;
+    run.seconds = 10;
+    run.scale = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            run.seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0) {
+            no_card = true;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc && run.npress < SIM_MAX_PRESSES) {
+            char *end;
+            press_t *p = &run.presses[run.npress++];
+            p->at_ms = strtoul(argv[++i], &end, 10);
+            p->hold_ms = (*end == ':') ? strtoul(end + 1, NULL, 10) : 100;
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && run.nalert < SIM_MAX_ALERTS) {
+            char *end;
+            alert_t *a = &run.alerts[run.nalert++];
+            a->at_ms = strtoul(argv[++i], &end, 10);
+            a->hold_ms = (*end == ':') ? strtoul(end + 1, &end, 10) : 1000;
+            a->code = (*end == ':') ? (uint8_t)strtoul(end + 1, NULL, 10) : 0;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            run.pgm = argv[++i];
+        } else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+            run.scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            char *arg = argv[++i];
+            char *colon = strrchr(arg, ':');
+            if (colon) {
+                *colon = '\0';
+                run.replay_speed = colon + 1;
+            }
+            run.replay = arg;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            run.stress = argv[++i];
+        } else {
+            usage();
+        }
+    }
+    if (run.seconds <= 0 || speed < 0 || run.scale < 1 || run.scale > 16) usage();
+    if (run.npress == 0) run.presses[run.npress++] = (press_t){ 300, 100 };
+    qsort(run.presses, run.npress, sizeof(run.presses[0]), cmp_press);
+
+    sim_storage_init(no_card ? NULL : dir);
+    if (run.replay && run.stress) usage();
+    if (!no_card && !stage_bench_files()) {
+        perror(run.replay ? run.replay : CAN_STRESS_CONFIG);
+        return 1;
+    }
+    sim_clock_set_speed(speed);
+
+    // app_main runs in the "main" task at priority 1, as in ESP-IDF
+    xTaskCreate(main_task, "main", 8192, NULL, 1, &run.app);
+    if (!run.replay && !run.stress) xTaskCreate(ecu_task, "ecu", 4096, NULL, SIM_OUTSIDE_PRIO, NULL);
+    xTaskCreate(bench_task, "bench", 4096, NULL, SIM_OUTSIDE_PRIO, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &run_wall);
+    vTaskStartScheduler();
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <string.h>
+#include "driver/i2c_master.h"
+#include "driver/gpio.h"
+#include "ssd1309_gfx.h"
+#include "sim.h"
+#include "sim_private.h"
+
+// Bits per byte on the wire (8 + ACK), and START + address + STOP overhead
+#define I2C_BITS_PER_BYTE   9
+#define I2C_BITS_OVERHEAD   11
+
+// --- GPIO ---
+
+static int gpio_level[GPIO_NUM_MAX];
+static bool gpio_driven[GPIO_NUM_MAX];     // Level set by sim_gpio_input()
+static bool gpio_pullup[GPIO_NUM_MAX];
+static gpio_int_type_t gpio_intr[GPIO_NUM_MAX];
+static gpio_isr_t gpio_isr[GPIO_NUM_MAX];
+static void *gpio_isr_arg[GPIO_NUM_MAX];
+static bool isr_service;
+
+static bool pin_ok(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    (void)mode;
+    return pin_ok(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    if (!pin_ok(gpio_num)) return ESP_ERR_INVALID_ARG;
+    gpio_pullup[gpio_num] = (pull == GPIO_PULLUP_ONLY || pull == GPIO_PULLUP_PULLDOWN);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!pin_ok(gpio_num)) return ESP_ERR_INVALID_ARG;
+    gpio_level[gpio_num] = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!pin_ok(gpio_num)) return 0;
+    int level = gpio_driven[gpio_num] ? gpio_level[gpio_num] : gpio_pullup[gpio_num];
+    return level;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!pin_ok(gpio_num)) return ESP_ERR_INVALID_ARG;
+    gpio_intr[gpio_num] = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+    if (isr_service) return ESP_ERR_INVALID_STATE;
+    isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!isr_service) return ESP_ERR_INVALID_STATE;
+    if (!pin_ok(gpio_num)) return ESP_ERR_INVALID_ARG;
+    gpio_isr[gpio_num] = isr_handler;
+    gpio_isr_arg[gpio_num] = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!pin_ok(gpio_num)) return ESP_ERR_INVALID_ARG;
+    gpio_isr[gpio_num] = NULL;
+    return ESP_OK;
+}
+
+void sim_gpio_input(gpio_num_t pin, int level)
+{
+    if (!pin_ok(pin)) return;
+    int was = gpio_get_level(pin);
+    gpio_level[pin] = level ? 1 : 0;
+    gpio_driven[pin] = true;
+
+    // Edge interrupts only, nothing in the firmware uses level ones
+    int now = gpio_level[pin];
+    gpio_int_type_t type = gpio_intr[pin];
+    bool fire = now != was && ((type == GPIO_INTR_ANYEDGE) ||
+                               (type == GPIO_INTR_POSEDGE && now) ||
+                               (type == GPIO_INTR_NEGEDGE && !now));
+    if (fire && gpio_isr[pin]) gpio_isr[pin](gpio_isr_arg[pin]);
+}
+
+int sim_gpio_output(gpio_num_t pin)
+{
+    if (!pin_ok(pin)) return 0;
+    int level = gpio_level[pin];
+    return level;
+}
+
+// --- SSD1309 on I2C ---
+// Page addressing only, which is what ssd1309_init() selects. Orientation
+// commands are accepted and ignored: the panel is mounted to undo them, so
+// GDDRAM as written is what the pilot sees
+
+struct i2c_master_bus_t {
+    int port;
+};
+
+struct i2c_master_dev_t {
+    uint16_t address;
+    uint32_t scl_hz;
+};
+
+static struct {
+    uint8_t gddram[SSD1309_BUFFER_SIZE];
+    int page;
+    int col;
+    int args_left;      // Parameter bytes still owed to the last command
+    sim_panel_stats_t stats;
+} panel;
+
+static struct i2c_master_bus_t the_bus;
+static struct i2c_master_dev_t the_dev;
+
+static void panel_command(uint8_t c)
+{
+    if (panel.args_left > 0) {
+        panel.args_left--;
+        return;
+    }
+    if (c <= 0x0F) {
+        panel.col = (panel.col & 0xF0) | c;
+    } else if (c <= 0x1F) {
+        panel.col = (panel.col & 0x0F) | ((c & 0x0F) << 4);
+    } else if (c >= 0xB0 && c <= 0xB7) {
+        panel.page = c & 0x07;
+    } else if (c == 0xAE || c == 0xAF) {
+        panel.stats.on = (c == 0xAF);
+    } else {
+        switch (c) {
+            // One parameter byte follows
+            case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+            case 0xD5: case 0xD9: case 0xDA: case 0xDB: case 0xFD:
+                panel.args_left = 1;
+                break;
+            // Column / page range, two parameters
+            case 0x21: case 0x22:
+                panel.args_left = 2;
+                break;
+        }
+    }
+}
+
+static void panel_data(uint8_t d)
+{
+    panel.gddram[panel.page * SCREEN_WIDTH + panel.col] = d;
+    panel.col = (panel.col + 1) % SCREEN_WIDTH;
+}
+
+// Control byte: bit 7 (Co) = one byte follows then another control byte,
+// bit 6 (D/C#) = data instead of commands
+static void panel_feed(const uint8_t *buf, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        uint8_t ctrl = buf[i++];
+        bool single = ctrl & 0x80;
+        bool data = ctrl & 0x40;
+        size_t end = single ? (i + 1 < len ? i + 1 : len) : len;
+        for (; i < end; i++) {
+            if (data) panel_data(buf[i]);
+            else panel_command(buf[i]);
+        }
+    }
+}
+
+// Returns how long the transfer keeps the bus
+static uint64_t panel_account(size_t len)
+{
+    uint32_t hz = the_dev.scl_hz ? the_dev.scl_hz : 100000;
+    uint64_t us = ((uint64_t)len * I2C_BITS_PER_BYTE + I2C_BITS_OVERHEAD) * 1000000ULL / hz;
+    panel.stats.transactions++;
+    panel.stats.bytes += len;
+    panel.stats.bus_us += us;
+    return us;
+}
+
+// The driver blocks until the last byte is out, so does the shim: frame
+// rates and everything timed around the display match the wheel
+static void bus_busy(uint64_t us)
+{
+    sim_sleep_until(sim_now_us() + (int64_t)us);
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    the_bus.port = bus_config->i2c_port;
+    *ret_bus_handle = &the_bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config,
+                                    i2c_master_dev_handle_t *ret_handle)
+{
+    (void)bus_handle;
+    the_dev.address = dev_config->device_address;
+    the_dev.scl_hz = dev_config->scl_speed_hz;
+    *ret_handle = &the_dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+                              int xfer_timeout_ms)
+{
+    (void)i2c_dev; (void)xfer_timeout_ms;
+    panel_feed(write_buffer, write_size);
+    uint64_t us = panel_account(write_size);
+    bus_busy(us);
+    return ESP_OK;
+}
+
+// One transaction, the buffers back to back
+esp_err_t i2c_master_multi_buffer_transmit(i2c_master_dev_handle_t i2c_dev,
+                                           i2c_master_transmit_multi_buffer_info_t *buffer_info_array,
+                                           size_t array_size, int xfer_timeout_ms)
+{
+    (void)i2c_dev; (void)xfer_timeout_ms;
+    uint8_t joined[1024 + 64];
+    size_t len = 0;
+    for (size_t i = 0; i < array_size; i++) {
+        size_t n = buffer_info_array[i].buffer_size;
+        if (len + n > sizeof(joined)) return ESP_ERR_INVALID_SIZE;
+        memcpy(joined + len, buffer_info_array[i].write_buffer, n);
+        len += n;
+    }
+    panel_feed(joined, len);
+    uint64_t us = panel_account(len);
+    bus_busy(us);
+    return ESP_OK;
+}
+
+void sim_panel_read(uint8_t *gddram)
+{
+    memcpy(gddram, panel.gddram, SSD1309_BUFFER_SIZE);
+}
+
+void sim_panel_get_stats(sim_panel_stats_t *stats)
+{
+    *stats = panel.stats;
+}
+
+bool sim_panel_write_pgm(const char *path, int scale)
+{
+    uint8_t fb[SSD1309_BUFFER_SIZE];
+    sim_panel_read(fb);
+    sim_panel_stats_t st;
+    sim_panel_get_stats(&st);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P5\n%d %d\n255\n", SCREEN_WIDTH * scale, SCREEN_HEIGHT * scale);
+    for (int y = 0; y < SCREEN_HEIGHT * scale; y++) {
+        int py = y / scale;
+        for (int x = 0; x < SCREEN_WIDTH * scale; x++) {
+            bool lit = st.on && (fb[(py / 8) * SCREEN_WIDTH + x / scale] >> (py % 8)) & 1;
+            fputc(lit ? 0xFF : 0x00, f);
+        }
+    }
+    return fclose(f) == 0;
+}
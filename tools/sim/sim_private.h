@@ -0,0 +1,18 @@
+#pragma once
+// Shared between the shim implementations only
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Virtual time, microseconds since boot
+int64_t sim_now_us(void);
+// When a FreeRTOS timeout of ticks from now expires, on the tick grid.
+// INT64_MAX for portMAX_DELAY
+int64_t sim_tick_deadline(TickType_t ticks);
+// Blocks the running task until sim_wake(obj) or deadline_us. false once
+// the deadline passed: callers re-check their condition and loop
+bool sim_wait(const void *obj, int64_t deadline_us);
+// Makes every task waiting on obj ready, a higher priority one runs now
+void sim_wake(const void *obj);
+// NVS file, NULL for a partition that forgets everything
+void sim_nvs_set_path(const char *path);
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include "driver/twai.h"
+#include "sim.h"
+#include "sim_private.h"
+
+// What the firmware sent, kept for the bench to read back
+#define SIM_TX_LOG_LEN  256
+#define SIM_CAN_BITRATE 500000
+
+// The controller's TX queue: frames leave one after the other, each taking
+// its wire time. A frame with self set lands in our own RX queue when its
+// last bit is out, like self reception on the controller. Always ACKed
+typedef struct {
+    twai_message_t msg;
+    int64_t done_us;
+} tx_slot_t;
+
+static struct {
+    bool installed;
+    twai_mode_t mode;
+    twai_state_t state;
+    twai_message_t *rx;
+    uint32_t rx_len;
+    uint32_t rx_head;
+    uint32_t rx_count;
+    uint32_t rx_high_water;
+    tx_slot_t *txq;
+    uint32_t txq_len;
+    uint32_t txq_head;
+    uint32_t txq_count;
+    int64_t wire_free_us;       // When the last queued frame is out
+    twai_message_t tx[SIM_TX_LOG_LEN];
+    uint32_t tx_head;
+    uint32_t tx_count;
+    twai_status_info_t stats;
+} bus;
+
+static const char tx_obj;       // Never woken, for waits on the wire
+
+uint32_t sim_can_frame_us(const twai_message_t *msg)
+{
+    // Overhead with IFS: 47 bits standard, 67 extended. No stuff bits
+    uint32_t bits = (msg->extd ? 67 : 47);
+    if (!msg->rtr) bits += 8 * (msg->data_length_code > 8 ? 8 : msg->data_length_code);
+    return bits * 1000000u / SIM_CAN_BITRATE;
+}
+
+static bool rx_push(const twai_message_t *msg)
+{
+    if (bus.rx_count == bus.rx_len) {
+        bus.stats.rx_missed_count++;
+        return false;
+    }
+    bus.rx[(bus.rx_head + bus.rx_count) % bus.rx_len] = *msg;
+    bus.rx_count++;
+    if (bus.rx_count > bus.rx_high_water) bus.rx_high_water = bus.rx_count;
+    sim_wake(&bus);
+    return true;
+}
+
+// Retires the frames whose last bit went out by now
+static void tx_advance(void)
+{
+    while (bus.txq_count > 0 && bus.txq[bus.txq_head].done_us <= sim_now_us()) {
+        twai_message_t msg = bus.txq[bus.txq_head].msg;
+        bus.txq_head = (bus.txq_head + 1) % bus.txq_len;
+        bus.txq_count--;
+
+        bus.tx[(bus.tx_head + bus.tx_count) % SIM_TX_LOG_LEN] = msg;
+        if (bus.tx_count < SIM_TX_LOG_LEN) bus.tx_count++;
+        else bus.tx_head = (bus.tx_head + 1) % SIM_TX_LOG_LEN;
+        // May switch to the RX task, the queue is consistent by now
+        if (msg.self) rx_push(&msg);
+    }
+}
+
+static void clear_queues(void)
+{
+    bus.rx_count = 0;
+    bus.txq_count = 0;
+}
+
+esp_err_t twai_driver_install(const twai_general_config_t *g_config, const twai_timing_config_t *t_config,
+                              const twai_filter_config_t *f_config)
+{
+    (void)t_config; (void)f_config;
+    if (bus.installed) return ESP_ERR_INVALID_STATE;
+    bus.rx_len = g_config->rx_queue_len ? g_config->rx_queue_len : 1;
+    bus.txq_len = g_config->tx_queue_len ? g_config->tx_queue_len : 1;
+    bus.rx = calloc(bus.rx_len, sizeof(twai_message_t));
+    bus.txq = calloc(bus.txq_len, sizeof(tx_slot_t));
+    bus.rx_head = bus.rx_count = bus.rx_high_water = 0;
+    bus.txq_head = bus.txq_count = 0;
+    bus.tx_head = bus.tx_count = 0;
+    memset(&bus.stats, 0, sizeof(bus.stats));
+    bus.mode = g_config->mode;
+    bus.state = TWAI_STATE_STOPPED;
+    bus.installed = bus.rx && bus.txq;
+    return bus.installed ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t twai_driver_uninstall(void)
+{
+    if (!bus.installed || bus.state == TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+    free(bus.rx);
+    free(bus.txq);
+    bus.rx = NULL;
+    bus.txq = NULL;
+    bus.installed = false;
+    return ESP_OK;
+}
+
+esp_err_t twai_start(void)
+{
+    if (!bus.installed || bus.state != TWAI_STATE_STOPPED) return ESP_ERR_INVALID_STATE;
+    bus.state = TWAI_STATE_RUNNING;
+    bus.stats.tx_error_counter = bus.stats.rx_error_counter = 0;
+    return ESP_OK;
+}
+
+esp_err_t twai_stop(void)
+{
+    if (!bus.installed || bus.state != TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+    bus.state = TWAI_STATE_STOPPED;
+    clear_queues();
+    return ESP_OK;
+}
+
+// Queues the frame, waiting for room like the driver does
+esp_err_t twai_transmit(const twai_message_t *message, TickType_t ticks_to_wait)
+{
+    int64_t deadline = sim_tick_deadline(ticks_to_wait);
+    for (;;) {
+        if (!bus.installed || bus.state != TWAI_STATE_RUNNING || bus.mode == TWAI_MODE_LISTEN_ONLY) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        tx_advance();
+        if (bus.txq_count < bus.txq_len) break;
+        int64_t room_at = bus.txq[bus.txq_head].done_us;
+        if (room_at > deadline) {
+            sim_wait(&tx_obj, deadline);
+            return ESP_ERR_TIMEOUT;
+        }
+        sim_wait(&tx_obj, room_at);
+    }
+    int64_t start = bus.wire_free_us > sim_now_us() ? bus.wire_free_us : sim_now_us();
+    bus.wire_free_us = start + sim_can_frame_us(message);
+    bus.txq[(bus.txq_head + bus.txq_count) % bus.txq_len] = (tx_slot_t){ *message, bus.wire_free_us };
+    bus.txq_count++;
+    // A receiver blocked before this frame was queued must wake when it is out
+    if (message->self) sim_wake(&bus);
+    return ESP_OK;
+}
+
+esp_err_t twai_receive(twai_message_t *message, TickType_t ticks_to_wait)
+{
+    if (!bus.installed) return ESP_ERR_INVALID_STATE;
+    int64_t deadline = sim_tick_deadline(ticks_to_wait);
+    for (;;) {
+        tx_advance();
+        if (bus.rx_count > 0 || sim_now_us() >= deadline) break;
+        // Our own frames coming back wake us up too
+        int64_t wake = deadline;
+        if (bus.txq_count > 0 && bus.txq[bus.txq_head].done_us < wake) wake = bus.txq[bus.txq_head].done_us;
+        sim_wait(&bus, wake);
+    }
+    if (bus.rx_count == 0) return ESP_ERR_TIMEOUT;
+    *message = bus.rx[bus.rx_head];
+    bus.rx_head = (bus.rx_head + 1) % bus.rx_len;
+    bus.rx_count--;
+    return ESP_OK;
+}
+
+// Recovery is instant here, the controller ends up stopped as on the chip
+esp_err_t twai_initiate_recovery(void)
+{
+    if (!bus.installed || bus.state != TWAI_STATE_BUS_OFF) return ESP_ERR_INVALID_STATE;
+    bus.state = TWAI_STATE_STOPPED;
+    return ESP_OK;
+}
+
+esp_err_t twai_get_status_info(twai_status_info_t *status_info)
+{
+    if (!bus.installed) return ESP_ERR_INVALID_STATE;
+    tx_advance();
+    *status_info = bus.stats;
+    status_info->state = bus.state;
+    status_info->msgs_to_rx = bus.rx_count;
+    status_info->msgs_to_tx = bus.txq_count;
+    return ESP_OK;
+}
+
+bool sim_can_inject(const twai_message_t *msg)
+{
+    if (!bus.installed || bus.state != TWAI_STATE_RUNNING) return false;
+    tx_advance();
+    return rx_push(msg);
+}
+
+bool sim_can_take_tx(twai_message_t *msg)
+{
+    if (bus.installed) tx_advance();
+    if (bus.tx_count == 0) return false;
+    *msg = bus.tx[bus.tx_head];
+    bus.tx_head = (bus.tx_head + 1) % SIM_TX_LOG_LEN;
+    bus.tx_count--;
+    return true;
+}
+
+void sim_can_bus_off(void)
+{
+    if (!bus.installed || bus.state != TWAI_STATE_RUNNING) return;
+    bus.state = TWAI_STATE_BUS_OFF;
+    bus.stats.tx_error_counter = 256;
+    clear_queues();
+}
+
+uint32_t sim_can_rx_high_water(void)
+{
+    return bus.rx_high_water;
+}